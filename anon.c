@@ -5,6 +5,16 @@
 #include "lib/kernel/bitmap.h"
 #include "devices/disk.h"
 #include "threads/mmu.h"
+#include "threads/malloc.h"
+#include "lib/round.h"
+#include "devices/timer.h"
+#include "vm/stats.h"
+#include "vm/trace.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/* 스왑 슬롯 하나(페이지 하나)를 이루는 섹터 수 */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -13,6 +23,28 @@ static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
 
 struct bitmap *swap_table;
+/* 스왑 슬롯마다 그 슬롯을 가리키는 페이지 수. 공유 프레임을 내보내면 공유자 전원이 한 슬롯을 가리킵니다.
+ * fork를 거듭하면 수백 개의 프로세스가 한 슬롯을 공유할 수 있으므로 넉넉한 폭을 씁니다. */
+static uint32_t *swap_refs;
+
+/* 스왑 슬롯 할당기. swap_table 비트맵 위에 요약 정보를 얹어 매번 0번부터 훑지 않게 합니다.
+ *  - swap_free_cnt: 전체 빈 슬롯 수. "스왑이 가득 찼는가"를 O(1)에 답합니다.
+ *  - swap_cursor: next-fit 커서. 마지막으로 할당한 자리 다음부터 찾고, 끝에 닿으면 처음으로 돕니다.
+ *  - swap_group_free: SWAP_GROUP 슬롯 묶음마다 빈 슬롯 수. 꽉 찬 묶음은 통째로 건너뜁니다. */
+#define SWAP_GROUP 64
+
+static size_t swap_slot_cnt, swap_group_cnt;
+static size_t swap_free_cnt;
+static size_t swap_cursor;
+static uint8_t *swap_group_free;
+
+static void swap_slot_put(int swap_idx);
+
+/* 스왑 입출력 통계. 페이지당 걸린 시간을 타이머 틱으로 모읍니다. */
+static unsigned swap_in_cnt, swap_out_cnt;
+static int64_t swap_in_ticks, swap_out_ticks;
+/* 스왑 캐시 덕분에 디스크에 쓰지 않고 버린 교체 횟수 */
+static unsigned swap_clean_cnt;
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
@@ -32,7 +64,244 @@ void vm_anon_init(void)
 	 * 스왑 테이블 엔트리에 이 엔트리가 비어있다는 비트 필요
 	 * bitmap 공부가 필요할듯
 	 */
-	swap_table = bitmap_create(disk_size(swap_disk) / (PGSIZE / DISK_SECTOR_SIZE));
+	swap_slot_cnt = disk_size(swap_disk) / SECTORS_PER_SLOT;
+	swap_group_cnt = DIV_ROUND_UP(swap_slot_cnt, SWAP_GROUP);
+	swap_table = bitmap_create(swap_slot_cnt);
+	swap_refs = calloc(swap_slot_cnt, sizeof *swap_refs);
+	swap_group_free = malloc(swap_group_cnt);
+	ASSERT(swap_table != NULL && swap_refs != NULL && swap_group_free != NULL);
+
+	for (size_t g = 0; g < swap_group_cnt; g++)
+		swap_group_free[g] = g + 1 < swap_group_cnt ? SWAP_GROUP : swap_slot_cnt - g * SWAP_GROUP;
+	swap_free_cnt = swap_slot_cnt;
+	swap_cursor = 0;
+}
+
+/* SLOT부터 CNT개 슬롯을 사용 중(USED) 또는 빈 상태로 표시하고 요약 정보를 맞춥니다. */
+static void
+swap_mark(size_t slot, size_t cnt, bool used)
+{
+	bitmap_set_multiple(swap_table, slot, cnt, used);
+	for (size_t i = slot; i < slot + cnt; i++)
+	{
+		if (used)
+			swap_group_free[i / SWAP_GROUP]--;
+		else
+			swap_group_free[i / SWAP_GROUP]++;
+	}
+	if (used)
+		swap_free_cnt -= cnt;
+	else
+		swap_free_cnt += cnt;
+}
+
+/* 슬롯의 참조를 하나 놓습니다. 마지막 참조였으면 슬롯을 비웁니다. */
+static void
+swap_slot_put(int swap_idx)
+{
+	ASSERT(swap_refs[swap_idx] > 0);
+	if (--swap_refs[swap_idx] == 0)
+		swap_mark(swap_idx, 1, false);
+}
+
+/* 방금 SRC가 내보내진 슬롯을 DST도 가리키게 합니다. 같은 프레임을 공유하던 페이지를 교체할 때 씁니다.
+ * DST가 스왑 캐시로 다른 슬롯을 붙들고 있었다면 그 슬롯은 놓습니다(내용은 같은 프레임이므로 SRC 쪽과 같습니다). */
+void anon_swap_share(struct page *dst, struct page *src)
+{
+	int swap_idx = src->anon.swap_idx;
+
+	ASSERT(swap_idx != -1);
+	if (dst->anon.swap_idx == swap_idx)
+		return;
+	anon_swap_drop(dst);
+	swap_refs[swap_idx]++;
+	dst->anon.swap_idx = swap_idx;
+}
+
+/* 연속된 스왑 슬롯 CNT개(SLOT부터)를 읽거나 씁니다.
+ * PAGES[i]는 SLOT + i 번 슬롯에 대응하는 페이지의 커널 주소입니다.
+ * 슬롯들이 디스크에서 이어져 있으므로 섹터 번호 순서대로 끊김 없이 요청하지만, 요청은 여전히 섹터마다
+ * disk_read/disk_write 하나씩입니다. devices/disk.c가 여러 섹터짜리 요청을 지원하면 여기만 바꾸면 됩니다. */
+static void
+swap_io(size_t slot, void **pages, size_t cnt, bool write)
+{
+	disk_sector_t sector = slot * SECTORS_PER_SLOT;
+
+	vm_stat_io(write, cnt * PGSIZE);
+
+	for (size_t i = 0; i < cnt; i++)
+		for (size_t j = 0; j < SECTORS_PER_SLOT; j++, sector++)
+		{
+			void *buf = (uint8_t *)pages[i] + j * DISK_SECTOR_SIZE;
+			if (write)
+				disk_write(swap_disk, sector, buf);
+			else
+				disk_read(swap_disk, sector, buf);
+		}
+}
+
+/* 이어진 빈 슬롯 CNT개를 잡아 첫 슬롯 번호를 돌려줍니다. 그런 자리가 없으면 -1.
+ * 커서가 있는 묶음부터 next-fit으로 찾고, 빈 슬롯이 없는 묶음은 건너뜁니다.
+ * 한 묶음 안에서는 시작 위치 SWAP_GROUP개만 보므로 묶음 하나를 보는 비용은 상수입니다.
+ * 마지막 바퀴(n == swap_group_cnt)는 커서 묶음의 커서 앞부분을 마저 봅니다. */
+int anon_swap_alloc_run(size_t cnt)
+{
+	if (cnt == 0 || swap_free_cnt < cnt)
+		return -1;
+
+	size_t g = swap_cursor / SWAP_GROUP;
+	for (size_t n = 0; n <= swap_group_cnt; n++, g = (g + 1) % swap_group_cnt)
+	{
+		if (swap_group_free[g] == 0)
+			continue;
+
+		size_t lo = g * SWAP_GROUP;
+		size_t hi = lo + SWAP_GROUP < swap_slot_cnt ? lo + SWAP_GROUP : swap_slot_cnt;
+		if (n == 0 && swap_cursor > lo)
+			lo = swap_cursor;
+
+		/* 시작 위치는 이 묶음 안이어야 하지만 연속 구간은 다음 묶음으로 넘어가도 됩니다 */
+		for (size_t slot = lo; slot < hi && slot + cnt <= swap_slot_cnt; slot++)
+			if (!bitmap_contains(swap_table, slot, cnt, true))
+			{
+				swap_mark(slot, cnt, true);
+				swap_cursor = (slot + cnt) % swap_slot_cnt;
+				return (int)slot;
+			}
+	}
+	return -1;
+}
+
+/* 스왑 슬롯 할당기 마이크로벤치마크. 커널 커맨드라인 -vm-swap-bench로 부팅 직후 한 번 돌립니다.
+ * 스왑 디스크를 한 슬롯씩 끝까지 채웠다가 비우고, SWAP_BENCH_RUN개짜리 구간으로 다시 채웠다 비운 뒤
+ * 각 단계에 걸린 틱을 출력합니다. 디스크 I/O는 하지 않으며 끝나면 할당기를 처음 상태로 되돌립니다. */
+#define SWAP_BENCH_ROUNDS 16
+#define SWAP_BENCH_RUN 8
+
+void anon_swap_bench(void)
+{
+	int64_t fill_ticks = 0, drain_ticks = 0, run_ticks = 0;
+	size_t run_cnt = swap_slot_cnt / SWAP_BENCH_RUN;
+
+	ASSERT(swap_free_cnt == swap_slot_cnt);
+	for (int round = 0; round < SWAP_BENCH_ROUNDS; round++)
+	{
+		int64_t start = timer_ticks();
+		for (size_t i = 0; i < swap_slot_cnt; i++)
+			if (anon_swap_alloc_run(1) == -1)
+				PANIC("swap-bench: 빈 슬롯이 남았는데 할당 실패");
+		if (anon_swap_alloc_run(1) != -1)
+			PANIC("swap-bench: 가득 찬 스왑에서 할당 성공");
+		fill_ticks += timer_elapsed(start);
+
+		/* 뒤섞인 순서로 비워서 커서가 구멍을 찾아다니게 합니다 */
+		start = timer_ticks();
+		for (size_t i = 0; i < swap_slot_cnt; i += 2)
+			swap_mark(i, 1, false);
+		for (size_t i = 1; i < swap_slot_cnt; i += 2)
+			swap_mark(i, 1, false);
+		drain_ticks += timer_elapsed(start);
+
+		start = timer_ticks();
+		for (size_t i = 0; i < run_cnt; i++)
+			if (anon_swap_alloc_run(SWAP_BENCH_RUN) == -1)
+				PANIC("swap-bench: 연속 구간 할당 실패");
+		swap_mark(0, run_cnt * SWAP_BENCH_RUN, false);
+		run_ticks += timer_elapsed(start);
+	}
+	swap_cursor = 0;
+
+	printf("swap-bench: slots %zu rounds %d fill %"PRId64" drain %"PRId64" run%d %"PRId64" ticks\n",
+		   swap_slot_cnt, SWAP_BENCH_ROUNDS, fill_ticks, drain_ticks, SWAP_BENCH_RUN, run_ticks);
+}
+
+/* 주소 순서대로 이어진 익명 페이지 CNT개를 FIRST_SLOT부터 이어진 슬롯에 씁니다(클러스터 스왑 아웃).
+ * 슬롯은 anon_swap_alloc_run으로 미리 잡아 두어야 하고, 페이지들의 매핑은 호출자가 끊어 둡니다. */
+void anon_swap_out_cluster(struct page **pages, size_t cnt, int first_slot)
+{
+	int64_t start = timer_ticks();
+
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct anon_page *anon_page = &pages[i]->anon;
+
+		swap_io(first_slot + i, &pages[i]->frame->kva, 1, true);
+		swap_refs[first_slot + i] = 1;
+		anon_page->swap_idx = first_slot + i;
+		vm_trace(VM_TRACE_SWAP_OUT, pages[i]->va, 0, first_slot + (int)i);
+	}
+	int64_t elapsed = timer_elapsed(start);
+	swap_out_ticks += elapsed;
+	swap_out_cnt += cnt;
+	vm_stat_time(VM_LAT_SWAP_OUT, elapsed);
+	vm_stat_add(VM_STAT_EVICT_SWAP, cnt);
+}
+
+/* 이어진 슬롯에 들어 있는 익명 페이지 CNT개를 KVAS로 한 번에 읽어 들입니다(클러스터 스왑 인).
+ * PAGES[0]의 슬롯부터 차례로 한 슬롯씩 이어져 있어야 합니다.
+ * 읽은 뒤에도 슬롯은 놓지 않습니다(스왑 캐시). 페이지가 더럽혀지지 않은 채 다시 교체되면
+ * 슬롯의 내용이 그대로 유효하므로 디스크에 쓰지 않고 프레임만 버리면 됩니다. */
+void anon_swap_in_cluster(struct page **pages, void **kvas, size_t cnt)
+{
+	int first_slot = pages[0]->anon.swap_idx;
+	int64_t start = timer_ticks();
+
+	swap_io(first_slot, kvas, cnt, false);
+	int64_t elapsed = timer_elapsed(start);
+	swap_in_ticks += elapsed;
+	swap_in_cnt += cnt;
+	vm_stat_time(VM_LAT_SWAP_IN, elapsed);
+
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct anon_page *anon_page = &pages[i]->anon;
+
+		ASSERT(anon_page->swap_idx == first_slot + (int)i);
+		vm_trace(VM_TRACE_SWAP_IN, pages[i]->va, 0, anon_page->swap_idx);
+	}
+}
+
+/* 스왑 캐시로 붙들고 있던 슬롯을 놓습니다. 프레임의 내용이 슬롯과 달라질 때(COW 복사 등) 부릅니다. */
+void anon_swap_drop(struct page *page)
+{
+	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->swap_idx == -1)
+		return;
+	swap_slot_put(anon_page->swap_idx);
+	anon_page->swap_idx = -1;
+}
+
+/* 스왑이 가득 찼을 때 스왑 캐시로 붙들고 있던 슬롯을 거둬들입니다. 돌려받은 슬롯 수를 돌려줍니다.
+ * 상주 중인 익명 페이지의 슬롯은 프레임에 같은 내용이 있으므로, 그 페이지 혼자 쓰는 슬롯이면 버려도 됩니다.
+ * 그 페이지는 다음에 교체될 때 새 슬롯에 다시 쓰입니다. 고정된 프레임은 입출력 중일 수 있어 건드리지 않습니다. */
+static size_t
+anon_swap_reclaim_cache(void)
+{
+	size_t freed = 0;
+
+	for (size_t i = 0; i < frame_table->frame_cnt; i++)
+	{
+		struct frame *frame = &frame_table->frames[i];
+		struct page *page = frame->page;
+
+		if (page == NULL || frame->pinned || frame->r_cnt != 1
+			|| VM_TYPE(page->operations->type) != VM_ANON)
+			continue;
+		if (page->anon.swap_idx != -1 && swap_refs[page->anon.swap_idx] == 1)
+		{
+			anon_swap_drop(page);
+			freed++;
+		}
+	}
+	return freed;
+}
+
+/* 스왑 입출력 통계를 출력합니다. 커널 종료 시 print_stats()에서 부릅니다. */
+void vm_anon_print_stats(void)
+{
+	printf("Swap: %u pages in (%"PRId64" ticks), %u pages out (%"PRId64" ticks), %u clean drops\n",
+		   swap_in_cnt, swap_in_ticks, swap_out_cnt, swap_out_ticks, swap_clean_cnt);
 }
 
 /* Initialize the file mapping */
@@ -51,13 +320,13 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 	return true;
 }
 
-/* 스왑 디스크에서 내용을 읽어와 페이지를 스왑인합니다. */
+/* 스왑 디스크에서 내용을 읽어와 페이지를 스왑인합니다. 슬롯은 스왑 캐시로 남겨 둡니다. */
 static bool
 anon_swap_in(struct page *page, void *kva)
 {
 	/** TODO: 페이지 스왑 인
 	 * disk_read를 데이터를 읽고 kva에 데이터 복사
-	 * swap_idx를 -1로 바꿔주어야 함
+	 * swap_idx는 그대로 둠 (스왑 캐시, 더럽혀지면 다음 스왑 아웃에서 무효화)
 	 * 프레임 테이블에 해당 프레임 넣어주기
 	 * 프레임하고 페이지 매핑해주기
 	 */
@@ -65,12 +334,7 @@ anon_swap_in(struct page *page, void *kva)
 	struct anon_page *anon_page = &page->anon;
 	int swap_idx = anon_page->swap_idx;
 	if(swap_idx !=-1){
-		for(int i=0; i<8; i++){
-			disk_read(swap_disk, (swap_idx * 8 )+ i , kva + (i * DISK_SECTOR_SIZE));
-		}
-		
-		bitmap_set(swap_table, swap_idx, false);
-		anon_page->swap_idx = -1;
+		anon_swap_in_cluster(&page, &kva, 1);
 		return true;
 	}
 	return false;
@@ -83,7 +347,7 @@ anon_swap_out(struct page *page)
 {
 	
 	/** TODO: disk_write를 사용하여 disk에 기록
-	 * 섹터 크기는 512바이트라 8번 반복해야합니다
+	 * 섹터 크기는 512바이트라 한 슬롯이 8섹터입니다 (swap_io가 한 번에 처리)
 	 * 비어있는 스왑 슬롯을 스왑 테이블에서 검색
 	 * 검색된 스왑 슬롯 인덱스를 anon_page에 저장
 	 * disk_write를 통해 해당 디스크 섹터에 저장
@@ -91,26 +355,37 @@ anon_swap_out(struct page *page)
 	if(page==NULL){
 		return false;
 	}
-	struct anon_page *anon_page = &page->anon;
-	struct frame *frame = page->frame;
 
-	int table_idx = bitmap_scan_and_flip(swap_table, 0, 1, 0);
-	if (table_idx == BITMAP_ERROR)
+	/* 스왑 캐시: 들여온 뒤로 아무도 쓰지 않았으면 슬롯의 내용이 그대로 유효합니다.
+	 * pml4_clear_page는 dirty 비트를 남기므로 매핑을 내린 뒤에도 판단할 수 있습니다. */
+	struct anon_page *anon_page = &page->anon;
+	if (anon_page->swap_idx != -1)
 	{
-		ASSERT(bitmap_test(swap_table, table_idx) == false);
-		return false;
-	}
-
-
-	for(int i=0; i<8; i++){
-		disk_write(swap_disk, (table_idx * 8) + i, frame->kva + (DISK_SECTOR_SIZE * i));
+		if (!frame_is_dirty(page->frame))
+		{
+			swap_clean_cnt++;
+			vm_stat_add(VM_STAT_EVICT_CLEAN, 1);
+			return true;
+		}
+		/* 더럽혀졌으면 슬롯은 낡았습니다. 혼자 쓰던 슬롯이면 그 자리에 다시 씁니다 */
+		if (swap_refs[anon_page->swap_idx] == 1)
+		{
+			int slot = anon_page->swap_idx;
+			anon_page->swap_idx = -1;
+			swap_refs[slot] = 0;
+			anon_swap_out_cluster(&page, 1, slot);
+			return true;
+		}
+		anon_swap_drop(page);
 	}
 
-	frame->r_cnt--;
-	page->frame->page = NULL;
-	page->frame = NULL;
+	int table_idx = anon_swap_alloc_run(1);
+	if (table_idx == -1 && anon_swap_reclaim_cache() > 0)
+		table_idx = anon_swap_alloc_run(1);
+	if (table_idx == -1)
+		return false;
 
-	anon_page->swap_idx=table_idx;
+	anon_swap_out_cluster(&page, 1, table_idx);
 
 	return true;
 
@@ -118,29 +393,24 @@ anon_swap_out(struct page *page)
 
 /* 익명 페이지를 소멸시킵니다. PAGE는 호출자가 해제합니다. */
 /** page->frame이 존재할 경우:
- *프레임 테이블에서 제거 (list_remove)
- *물리 메모리 해제 (palloc_free_page)
- *프레임 구조체 메모리 해제 (free)
+ *프레임 역매핑에서 이 페이지를 빼고, 마지막 사용자였다면 프레임을 돌려줌 (frame_table_unlink)
  */
 static void
 anon_destroy(struct page *page)
 {
     struct anon_page *anon_page = &page->anon;
 
+    /* 회수 스레드나 다른 프로세스가 이 프레임을 내보내는 중이면 page->frame과 swap_idx가 바뀌고 있으므로
+     * 교체 락을 잡고 정리합니다 */
+    frame_table_lock();
     pml4_clear_page(thread_current()->pml4, page->va);
 
     if (anon_page->swap_idx != -1)
-        bitmap_set(swap_table, anon_page->swap_idx, false);
-
-    if (page->frame != NULL) {
-		page->frame->r_cnt--;
-		if(page->frame->r_cnt==0){
-			list_remove(&page->frame->frame_elem);
-			palloc_free_page(page->frame->kva);
-			page->frame->page = NULL; // 연결 해제 (구현에 따라)
-			free(page->frame);
-		}
-    }
+        swap_slot_put(anon_page->swap_idx);
+
+    /* 다른 프로세스와 공유 중이면 역매핑에서 이 페이지만 빠지고, 마지막이면 프레임이 풀로 돌아갑니다 */
+    frame_table_unlink(page);
+    frame_table_unlock();
 
 	
 }
@@ -1,9 +1,17 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "vm/slab.h"
+#include "vm/page_cache.h"
+#include "vm/stats.h"
+#include "devices/timer.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "threads/mmu.h"
+#include "threads/malloc.h"
+#include "lib/round.h"
+#include <stdlib.h>
+#include <string.h>
 
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
@@ -44,6 +52,159 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 	return true;
 }
 
+/* 상주 중인 파일 기반 PAGE가 더럽혀졌으면 파일에 써 두고 dirty 비트를 지웁니다. 썼으면 true.
+ * dirty 비트를 쓰기 전에 지우므로, 쓰는 도중에 들어온 수정은 다시 dirty로 남아 다음 번에 써집니다.
+ * 플러셔 스레드, 교체, 소멸, msync가 모두 이 함수로 write-back 합니다. */
+bool file_backed_flush(struct page *page)
+{
+	struct file_info *aux = page->file.aux;
+	struct frame *frame = page->frame;
+
+	if (frame == NULL || !frame_is_dirty(frame))
+		return false;
+
+	/* 쓰는 동안 회수 스레드가 프레임을 가져가 재사용하지 않도록 고정합니다 */
+	bool pinned = frame->pinned;
+	frame->pinned = true;
+	frame_clear_dirty(frame);
+	int64_t start = timer_ticks();
+	lock_acquire(&filesys_lock);
+	file_write_at(aux->file, frame->kva, aux->read_bytes, aux->ofs);
+	lock_release(&filesys_lock);
+	vm_stat_time(VM_LAT_WRITEBACK, timer_elapsed(start));
+	vm_stat_io(true, aux->read_bytes);
+	vm_stat_add(VM_STAT_WRITEBACK, 1);
+	/* 다른 프로세스가 같은 파일 페이지의 예전 내용을 캐시에서 받아 가지 않도록 합니다 */
+	vm_pagecache_invalidate(file_get_inode(aux->file), aux->ofs);
+	frame->pinned = pinned;
+	return true;
+}
+
+/* 주인 프로세스 문맥에서 PAGE를 파일에 씁니다. frame_table_lock을 잡은 채 부르고, 돌아올 때도 잡혀 있습니다.
+ * 프레임을 고정한 뒤 쓰기 동안만 락을 놓으므로 그 사이 교체가 프레임을 가져가지 못합니다.
+ * 더럽혀진 파일 프레임은 이 페이지 혼자 쓰는 프레임이라 고정을 다른 사용자와 다툴 일이 없습니다. */
+static bool
+file_backed_flush_owned(struct page *page)
+{
+	struct frame *frame = page->frame;
+
+	if (frame == NULL || !frame_is_dirty(frame))
+		return false;
+	frame->pinned = true;
+	frame_table_unlock();
+	bool written = file_backed_flush(page);
+	frame_table_lock();
+	frame->pinned = false;
+	return written;
+}
+
+/* 한 번의 file_write_at으로 합쳐 쓰는 최대 페이지 수 */
+#define FLUSH_RUN_MAX 16
+
+/* 더럽혀진 파일 페이지를 (inode, 파일 오프셋) 순으로 정렬합니다. */
+static int
+flush_order(const void *a_, const void *b_)
+{
+	const struct file_info *a = (*(struct page *const *)a_)->file.aux;
+	const struct file_info *b = (*(struct page *const *)b_)->file.aux;
+	struct inode *ia = file_get_inode(a->file), *ib = file_get_inode(b->file);
+
+	if (ia != ib)
+		return ia < ib ? -1 : 1;
+	return a->ofs < b->ofs ? -1 : a->ofs > b->ofs;
+}
+
+/* NEXT가 PREV 바로 뒤를 이어 같은 쓰기에 합칠 수 있는 페이지인지 봅니다.
+ * PREV가 페이지를 꽉 채우지 않으면(zero_bytes가 있으면) 그 뒤는 파일에 쓰면 안 되므로 끊습니다. */
+static bool
+flush_adjacent(struct page *prev, struct page *next)
+{
+	struct file_info *p = prev->file.aux, *n = next->file.aux;
+
+	return file_get_inode(p->file) == file_get_inode(n->file)
+		&& p->read_bytes == PGSIZE && n->ofs == p->ofs + PGSIZE;
+}
+
+/* PAGES 중 상주하는 더럽혀진 파일 기반 페이지를 모아 파일 오프셋 순으로 정렬하고,
+ * 같은 파일에서 이어진 페이지는 바운스 버퍼에 모아 한 번의 file_write_at으로 씁니다.
+ * 각 페이지의 read_bytes까지만 쓰므로 끝의 zero_bytes 영역은 파일에 반영되지 않습니다.
+ * munmap과 프로세스 종료가 페이지마다 따로 쓰지 않도록 부릅니다. 쓰기 호출 횟수를 돌려줍니다. */
+size_t file_backed_flush_pages(struct page **pages, size_t cnt)
+{
+	if (cnt == 0)
+		return 0;
+
+	struct page **dirty = malloc(cnt * sizeof *dirty);
+	uint8_t *buf = malloc(FLUSH_RUN_MAX * PGSIZE);
+	size_t dirty_cnt = 0, writes = 0;
+
+	if (dirty == NULL || buf == NULL)
+	{
+		/* 메모리가 모자라면 페이지마다 쓰는 원래 방식으로 물러납니다 */
+		frame_table_lock();
+		for (size_t i = 0; i < cnt; i++)
+			if (VM_TYPE(pages[i]->operations->type) == VM_FILE && file_backed_flush_owned(pages[i]))
+				writes++;
+		frame_table_unlock();
+		free(dirty);
+		free(buf);
+		return writes;
+	}
+
+	/* 쓸 페이지의 프레임은 내용을 버퍼에 옮길 때까지 고정해 둡니다. 교체와 플러셔가 고르는 중이 아닐 때 고정합니다 */
+	frame_table_lock();
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct page *page = pages[i];
+		struct frame *frame = page->frame;
+
+		if (VM_TYPE(page->operations->type) != VM_FILE || frame == NULL || frame->pinned)
+			continue;
+		frame->pinned = true;
+		if (frame_is_dirty(frame))
+			dirty[dirty_cnt++] = page;
+		else
+			frame->pinned = false;
+	}
+	frame_table_unlock();
+	qsort(dirty, dirty_cnt, sizeof *dirty, flush_order);
+
+	for (size_t i = 0; i < dirty_cnt;)
+	{
+		size_t n = 1;
+		while (i + n < dirty_cnt && n < FLUSH_RUN_MAX && flush_adjacent(dirty[i + n - 1], dirty[i + n]))
+			n++;
+
+		size_t bytes = 0;
+		for (size_t k = 0; k < n; k++)
+		{
+			struct page *page = dirty[i + k];
+			struct file_info *aux = page->file.aux;
+
+			frame_clear_dirty(page->frame);
+			memcpy(buf + k * PGSIZE, page->frame->kva, aux->read_bytes);
+			bytes = k * PGSIZE + aux->read_bytes;
+			page->frame->pinned = false;
+			vm_pagecache_invalidate(file_get_inode(aux->file), aux->ofs);
+		}
+
+		struct file_info *first = dirty[i]->file.aux;
+		int64_t start = timer_ticks();
+		lock_acquire(&filesys_lock);
+		file_write_at(first->file, buf, bytes, first->ofs);
+		lock_release(&filesys_lock);
+		vm_stat_time(VM_LAT_WRITEBACK, timer_elapsed(start));
+		vm_stat_add(VM_STAT_WRITEBACK, n);
+		vm_stat_io(true, bytes);
+		writes++;
+		i += n;
+	}
+
+	free(buf);
+	free(dirty);
+	return writes;
+}
+
 /* 파일에서 내용을 읽어와 페이지를 스왑인합니다. */
 static bool
 file_backed_swap_in(struct page *page, void *kva)
@@ -63,6 +224,7 @@ file_backed_swap_in(struct page *page, void *kva)
 	size_t length= aux->read_bytes;
 	off_t offset = aux->ofs;
 
+	int64_t start = timer_ticks();
 	lock_acquire(&filesys_lock);
 	if (file_read_at(file, kva, length, offset) != (int)length) {
         // 읽기 실패 시 처리
@@ -70,6 +232,8 @@ file_backed_swap_in(struct page *page, void *kva)
         return false;
     }
 	lock_release(&filesys_lock);
+	vm_stat_time(VM_LAT_FILE_READ, timer_elapsed(start));
+	vm_stat_io(false, length);
 
 	size_t page_zero_bytes = PGSIZE - length;
     if (page_zero_bytes > 0) {
@@ -89,21 +253,10 @@ file_backed_swap_out(struct page *page)
 	 * file_write를 사용하면 될 것 같아요
 	 * dirty_bit 초기화 (pml4_set_dirty)
 	 */
-	struct file_page *file_page = &page->file;
-	struct file_info *aux=file_page->aux;
-
-	uint32_t read_bytes = aux->read_bytes;
-	uint32_t zero_bytes = aux->zero_bytes;
-	struct file * file = aux->file;
-	off_t offset=aux->ofs;
-
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
-	}
+	/* 교체는 다른 프로세스 문맥에서도 일어나고 프레임이 공유 중일 수도 있으므로
+	 * 프레임을 매핑한 모든 주소 공간의 dirty 비트를 봐야 합니다.
+	 * 보통은 플러셔가 이미 써 두었으므로 여기서는 매핑만 끊고 끝납니다 */
+	vm_stat_add(file_backed_flush(page) ? VM_STAT_EVICT_FILE : VM_STAT_EVICT_CLEAN, 1);
 
 	// page->frame->page=NULL;
 	// page->frame=NULL;
@@ -118,31 +271,19 @@ file_backed_destroy(struct page *page)
 {
 	struct file_page *file_page = &page->file;
 	struct file_info *aux=file_page->aux;
-	uint32_t read_bytes = aux->read_bytes;
-	uint32_t zero_bytes = aux->zero_bytes;
-	struct file * file = aux->file;
-	off_t offset=aux->ofs;
 
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
-	}
+	/* 플러셔가 이 페이지를 쓰는 중이면 끝나길 기다렸다가, 더럽혀졌으면 써 두고 연결을 끊습니다 */
+	frame_table_lock();
+	file_backed_flush_owned(page);
 
-	if (page->frame != NULL)
-	{
-		// 물리 페이지를 해제하고, frame 구조체도 동적 메모리 해제
-		palloc_free_page(page->frame->kva);
-		free(page->frame);
-		page->frame = NULL;
-	}	
+	// 프레임 역매핑에서 빠지고, 마지막 사용자였다면 물리 페이지를 프레임 테이블에 돌려줌
+	frame_table_unlink(page);
 	
 	// 최종적으로 사용자 가상 주소 공간에서 해당 페이지 매핑을 제거
 	pml4_clear_page(thread_current()->pml4, page->va);
+	frame_table_unlock();
 
-	free(aux);
+	file_info_free(aux);
 }
 
 /* Do the mmap */
@@ -152,70 +293,133 @@ file_backed_destroy(struct page *page)
 */
 
 
+/* 매핑 전체(mmap_length 바이트)를 TYPE 페이지의 영역 하나로 기록합니다. 페이지는 처음 폴트 때 만들어집니다.
+ * 페이지마다 do_mmap을 부르는 호출자를 위해, 같은 파일의 같은 자리를 매핑한 영역이 이미 덮고 있는 주소면
+ * 아무것도 하지 않습니다. 다른 영역이나 이미 있는 페이지와 겹치면 실패합니다.
+ * LENGTH는 첫 페이지에서 읽을 바이트 수로, mmap_length를 모를 때(0)만 씁니다. */
+static void *
+mmap_region(void *addr, size_t length, int writable,
+			struct file *file, off_t offset, size_t mmap_length, enum vm_type type)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct vm_region *region = vm_region_find(spt, addr);
+	if (region != NULL)
+		return vm_region_maps(region, addr, file, offset) ? addr : NULL;
+
+	size_t map_bytes = mmap_length > 0 ? mmap_length : length;
+	size_t file_bytes = length;
+	if (mmap_length > 0)
+	{
+		lock_acquire(&filesys_lock);
+		off_t file_len = file_length(file);
+		lock_release(&filesys_lock);
+		file_bytes = file_len > offset ? (size_t)(file_len - offset) : 0;
+	}
+
+	if (!vm_region_add(addr, ROUND_UP(map_bytes, PGSIZE), file, offset, file_bytes, writable, type, mmap_length))
+		return NULL;
+	return addr;
+}
+
+/* 공유 매핑. 쓴 내용은 write-back으로 파일에 반영됩니다. */
 void *
 do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset, size_t mmap_length)
 {
-	// aux에 넣어줄 정보
-	struct file_info *aux = malloc(sizeof(struct file_info));
-	ASSERT(aux!=NULL);
-
-	aux->file=file_reopen(file);
-	aux->ofs=offset;
-	aux->upage=addr;
-	aux->read_bytes=length; //한 페이지당 읽어와야할 바이트 수
-	aux->zero_bytes=PGSIZE-length;
-	aux->writable=writable;
-	aux->mmap_length = mmap_length;
-
+	return mmap_region(addr, length, writable, file, offset, mmap_length, VM_FILE);
+}
 
-	// TODO: 지연 로딩 함수 포인터 집어넣기
-	if(!vm_alloc_page_with_initializer(VM_FILE, addr, writable, lazy_load_segment, aux)) //<<어떻게 lazy_load_segemnt를 집어넣지?
-		return NULL;
-	return addr;
+/* 사적(copy-on-write) 매핑. 페이지는 실행 파일 세그먼트처럼 파일에서 읽어 오는 익명 페이지로 만들어지므로
+ * 페이지 캐시의 프레임을 읽기 전용으로 함께 쓰다가, 첫 쓰기 때 vm_handle_wp에서 제 프레임으로 떼어 집니다.
+ * 쓴 내용은 파일에 돌아가지 않고 교체되면 스왑 디스크로 나갑니다. */
+void *
+do_mmap_private(void *addr, size_t length, int writable,
+				struct file *file, off_t offset, size_t mmap_length)
+{
+	return mmap_region(addr, length, writable, file, offset, mmap_length, VM_ANON);
 }
 
 
 
-static void
-munmap_cleaner(struct page *page)
+/* msync: 현재 주소 공간의 [ADDR, ADDR + LENGTH)에 걸친 파일 기반 페이지 중 더럽혀진 것을
+ * 지금 바로 파일에 씁니다. 플러셔를 기다리지 않고 내구성이 필요한 호출자가 씁니다.
+ * 써 넣은 페이지 수를 돌려줍니다. */
+size_t vm_file_sync(void *addr, size_t length)
 {
-	struct file_info * aux;
-	if(page->operations->type==VM_FILE){
-		aux = page->file.aux;
-	}else{
-	    aux= (struct file_info *)page->uninit.aux;
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *start = pg_round_down(addr);
+	uint8_t *end = (uint8_t *)addr + length;
+	size_t written = 0;
+
+	/* 회수 스레드가 쓰는 도중의 프레임을 가져가 재사용하지 않도록 소멸과 같은 방식으로 고정하고 씁니다 */
+	frame_table_lock();
+	for (uint8_t *va = start; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+		if (page != NULL && VM_TYPE(page->operations->type) == VM_FILE && file_backed_flush_owned(page))
+			written++;
 	}
+	frame_table_unlock();
+	return written;
+}
 
-	uint32_t read_bytes=aux->read_bytes;
-	uint32_t zero_bytes=aux->zero_bytes;
-	struct file* file = aux->file;
-	off_t offset=aux->ofs;
-
-	
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		
-		lock_acquire(&filesys_lock);
-		file_write_at(file, page->frame->kva, read_bytes, offset);
-		lock_release(&filesys_lock);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
-	}
-	free(aux);
+/* mmap으로 만든 페이지(아직 올라오지 않은 것 포함)면 그 파일 정보를 돌려줍니다. */
+static struct file_info *
+mmap_page_info(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_FILE)
+		return page->file.aux;
+	if (VM_TYPE(page->operations->type) == VM_UNINIT && VM_TYPE(page->uninit.type) == VM_FILE)
+		return page->uninit.aux;
+	return NULL;
 }
 
+/* 한 번에 모아 write-back 하는 페이지 수. 커널 스택에 배열로 둡니다 */
+#define MUNMAP_BATCH 32
 
 /* Do the munmap */
-/* 언매핑시 0으로 채워진 부분은 파일에 반영하지 않아야 함.*/
+/* 언매핑시 0으로 채워진 부분은 파일에 반영하지 않아야 함.
+ * ADDR에서 시작하는 매핑 전체를 한 번에 해제합니다. 영역을 먼저 없애 더 이상 페이지가 만들어지지 않게 한 뒤,
+ * 실제로 만들어진 페이지만 MUNMAP_BATCH개씩 모아 file_backed_flush_pages로 합쳐 쓰고 없앱니다.
+ * 사적 매핑의 (익명) 페이지는 file_backed_flush_pages가 건너뛰므로 쓰지 않고 없애기만 합니다.
+ * 이미 해제된 주소면 아무 일도 하지 않습니다. */
 void do_munmap(void *addr)
 {
 	struct thread *thread = thread_current(); 
-	struct page *page = spt_find_page(&thread->spt, addr);
-	ASSERT(page != NULL);
-		
-	// 페이지 제거
-	hash_delete(&thread->spt.spt_hash, &page->hash_elem);
-	munmap_cleaner(page);
-	// free(page);
-	pml4_clear_page(thread->pml4, pg_round_down(addr));
+	struct page *batch[MUNMAP_BATCH];
+	uint8_t *start = pg_round_down(addr);
+	size_t length = vm_region_remove(&thread->spt, start);
+	bool whole_range = length > 0;
 
+	/* 영역 없이 페이지로만 만들어진 매핑(예전 방식)은 첫 페이지의 mmap_length로 범위를 정합니다 */
+	if (length == 0)
+	{
+		struct page *page = spt_peek_page(&thread->spt, start);
+		struct file_info *info = page != NULL ? mmap_page_info(page) : NULL;
+		if (info == NULL)
+			return;
+		length = info->mmap_length > 0 ? ROUND_UP(info->mmap_length, PGSIZE) : PGSIZE;
+	}
+
+	/* SPT를 주소 순으로 훑으므로 만들어지지 않은 페이지 자리는 건너뜁니다 */
+	void *cursor = start;
+	size_t cnt;
+	do
+	{
+		struct page *p;
+		cnt = 0;
+		while (cnt < MUNMAP_BATCH && (p = spt_next_page(&thread->spt, &cursor)) != NULL
+			   && (uint8_t *)p->va < start + length)
+			if (whole_range || mmap_page_info(p) != NULL)
+				batch[cnt++] = p;
+
+		file_backed_flush_pages(batch, cnt);
+
+		// 페이지 제거: 이미 깨끗하므로 destroy는 매핑과 프레임만 정리합니다
+		for (size_t i = 0; i < cnt; i++)
+		{
+			spt_remove_page(&thread->spt, batch[i]);
+			vm_dealloc_page(batch[i]);
+		}
+	} while (cnt == MUNMAP_BATCH);
 }
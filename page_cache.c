@@ -0,0 +1,153 @@
+/* page_cache.c: 프로세스들이 함께 쓰는 파일 페이지 캐시.
+ *
+ * 같은 프로그램을 여러 번 띄우면 프로세스마다 코드 페이지를 디스크에서 다시 읽어 제 프레임에 담습니다.
+ * 이 캐시는 파일에서 읽어 올린 프레임을 (inode, 페이지 오프셋)으로 기록해 두고,
+ * 다른 프로세스가 같은 파일 페이지에서 읽기 폴트를 내면 디스크를 읽는 대신 그 프레임을
+ * 읽기 전용으로 함께 매핑하게 합니다(r_cnt 공유, 쓰기는 vm_handle_wp의 copy-on-write).
+ *
+ * 캐시는 프레임을 소유하지 않습니다. 항목은 프레임마다 하나씩 프레임 테이블과 나란한 배열에 두고,
+ * 프레임이 풀로 돌아가거나 교체되거나 누군가 그 프레임에 직접 쓰게 되면 항목을 지웁니다.
+ * 그래서 캐시에 있는 프레임은 언제나 적어도 한 페이지가 매핑하고 있는 깨끗한 프레임입니다.
+ * */
+
+#include "vm/vm.h"
+#include "vm/page_cache.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "lib/kernel/hash.h"
+#include <debug.h>
+#include <stdio.h>
+
+struct pc_entry {
+	struct hash_elem elem;
+	struct inode *inode;	/* NULL이면 빈 항목 */
+	off_t ofs;
+	size_t read_bytes;		/* 같은 오프셋이라도 파일에서 읽은 길이(나머지는 0)가 같아야 내용이 같습니다 */
+	enum vm_type type;		/* 공유자들이 같은 방식으로 내보내지도록 페이지 타입도 맞춥니다 */
+	struct frame *frame;
+};
+
+static struct hash pc_hash;
+static struct pc_entry *pc_entries;		/* frame_table->frames와 같은 번호 */
+static struct lock pc_lock;
+static unsigned pc_hits, pc_misses;
+
+static unsigned
+pc_hash_func(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct pc_entry *entry = hash_entry(e, struct pc_entry, elem);
+	return hash_bytes(&entry->inode, sizeof entry->inode) ^ hash_int(entry->ofs);
+}
+
+static bool
+pc_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED)
+{
+	const struct pc_entry *a = hash_entry(a_, struct pc_entry, elem);
+	const struct pc_entry *b = hash_entry(b_, struct pc_entry, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
+
+static struct pc_entry *
+pc_entry_of(struct frame *frame)
+{
+	return &pc_entries[frame - frame_table->frames];
+}
+
+/* 프레임 테이블을 만든 뒤에 불러야 합니다. */
+void vm_pagecache_init(void)
+{
+	pc_entries = calloc(frame_table->frame_cnt, sizeof *pc_entries);
+	ASSERT(frame_table->frame_cnt == 0 || pc_entries != NULL);
+	hash_init(&pc_hash, pc_hash_func, pc_less, NULL);
+	lock_init(&pc_lock);
+}
+
+/* (INODE, OFS) 페이지를 READ_BYTES만큼 읽어 둔 TYPE 페이지의 프레임을 찾습니다. 없으면 NULL.
+ * 돌려준 프레임은 고정해서 주므로, 호출자는 매핑을 마친 뒤 pinned를 풀어야 합니다.
+ * 교체와 겹치지 않도록 evict_lock을 잡은 채 불러야 하고, 역매핑에 넣는 것도 그 락을 놓기 전에 해야 합니다. */
+struct frame *
+vm_pagecache_lookup(struct inode *inode, off_t ofs, size_t read_bytes, enum vm_type type)
+{
+	struct pc_entry key = { .inode = inode, .ofs = ofs };
+	struct frame *frame = NULL;
+
+	lock_acquire(&pc_lock);
+	struct hash_elem *e = hash_find(&pc_hash, &key.elem);
+	if (e != NULL)
+	{
+		struct pc_entry *entry = hash_entry(e, struct pc_entry, elem);
+		/* 항목이 가리키는 프레임이 아직 그 파일 페이지를 담고 있는지(누군가 매핑하고 있는지)도 확인합니다 */
+		if (entry->read_bytes == read_bytes && entry->type == type && entry->frame->r_cnt > 0
+			&& !entry->frame->pinned)
+		{
+			frame = entry->frame;
+			frame->pinned = true;
+		}
+	}
+	if (frame != NULL)
+		pc_hits++;
+	else
+		pc_misses++;
+	lock_release(&pc_lock);
+	return frame;
+}
+
+/* 파일에서 방금 읽어 온 FRAME을 캐시에 넣습니다. 같은 파일 페이지가 이미 있으면 그대로 둡니다.
+ * 호출자는 FRAME을 매핑한 모든 곳이 읽기 전용임을 보장해야 합니다. */
+void vm_pagecache_insert(struct frame *frame, struct inode *inode, off_t ofs,
+						 size_t read_bytes, enum vm_type type)
+{
+	struct pc_entry *entry = pc_entry_of(frame);
+
+	lock_acquire(&pc_lock);
+	if (entry->inode == NULL)
+	{
+		entry->inode = inode;
+		entry->ofs = ofs;
+		entry->read_bytes = read_bytes;
+		entry->type = type;
+		entry->frame = frame;
+		if (hash_insert(&pc_hash, &entry->elem) != NULL)
+			entry->inode = NULL;
+	}
+	lock_release(&pc_lock);
+}
+
+/* FRAME이 캐시에 있으면 뺍니다. 프레임을 풀에 돌려주거나 다른 내용으로 다시 쓰기 전,
+ * 또는 한 페이지가 그 프레임에 직접 쓰게 되기 전에 불러야 합니다. */
+void vm_pagecache_forget(struct frame *frame)
+{
+	struct pc_entry *entry = pc_entry_of(frame);
+
+	if (entry->inode == NULL)
+		return;
+	lock_acquire(&pc_lock);
+	if (entry->inode != NULL)
+	{
+		hash_delete(&pc_hash, &entry->elem);
+		entry->inode = NULL;
+	}
+	lock_release(&pc_lock);
+}
+
+/* 파일의 (INODE, OFS) 페이지 내용이 바뀌었으므로 캐시 항목을 지웁니다.
+ * 이미 그 프레임을 매핑한 페이지는 그대로 두고, 이후의 폴트만 파일에서 새로 읽게 합니다. */
+void vm_pagecache_invalidate(struct inode *inode, off_t ofs)
+{
+	struct pc_entry key = { .inode = inode, .ofs = ofs };
+
+	lock_acquire(&pc_lock);
+	struct hash_elem *e = hash_delete(&pc_hash, &key.elem);
+	if (e != NULL)
+		hash_entry(e, struct pc_entry, elem)->inode = NULL;
+	lock_release(&pc_lock);
+}
+
+/* 캐시에 든 프레임 수와 적중/실패 횟수를 출력합니다. */
+void vm_pagecache_print_stats(void)
+{
+	printf("Page cache: %zu frames, %u hits, %u misses\n", hash_size(&pc_hash), pc_hits, pc_misses);
+}
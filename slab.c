@@ -0,0 +1,153 @@
+/* slab.c: VM 메타데이터를 위한 고정 크기 객체 캐시(slab).
+ *
+ * 폴트와 매핑 경로에서 자주 만들고 없애는 작은 구조체(struct file_info, 역매핑 항목)를
+ * 범용 malloc 대신 크기별 캐시에서 꺼내 씁니다. 캐시는 커널 풀 페이지 한 장을 슬랩으로 삼아
+ * 같은 크기의 객체로 잘라 두고, 슬랩마다 빈 객체를 연결 리스트로 묶어 둡니다.
+ * 할당과 해제는 그 리스트에서 포인터 하나를 꺼내거나 넣는 것으로 끝납니다.
+ * */
+
+#include "vm/slab.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/interrupt.h"
+#include <debug.h>
+#include <stdio.h>
+
+#define SLAB_MAGIC 0x51ab51ab
+
+/* 슬랩 헤더. 슬랩 페이지의 맨 앞에 있고, 객체는 그 뒤를 잘라 씁니다.
+ * 객체 주소를 페이지 경계로 내리면 헤더가 나오므로 해제할 때 따로 찾을 필요가 없습니다. */
+struct slab {
+	unsigned magic;
+	struct slab_cache *cache;
+	struct list_elem elem;	/* cache->partial 또는 cache->full */
+	size_t used;			/* 나가 있는 객체 수 */
+	void *free;				/* 빈 객체 연결 리스트(객체의 첫 8바이트에 다음 주소) */
+};
+
+/* 통계 출력을 위해 만든 캐시를 모두 엮어 둡니다 */
+static struct list caches = LIST_INITIALIZER(caches);
+
+/* CACHE를 OBJ_SIZE 바이트 객체용으로 준비합니다. 슬랩은 첫 할당 때 만듭니다. */
+void slab_cache_init(struct slab_cache *cache, const char *name, size_t obj_size)
+{
+	obj_size = obj_size < sizeof(void *) ? sizeof(void *) : obj_size;
+	cache->name = name;
+	cache->obj_size = (obj_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	cache->per_slab = (PGSIZE - sizeof(struct slab)) / cache->obj_size;
+	ASSERT(cache->per_slab > 0);
+	list_init(&cache->partial);
+	list_init(&cache->full);
+	cache->slab_cnt = 0;
+	cache->active_cnt = 0;
+	cache->empty_cnt = 0;
+	list_push_back(&caches, &cache->elem);
+}
+
+/* 새 슬랩을 만들어 모든 객체를 빈 리스트에 엮고 partial에 넣습니다. */
+static struct slab *
+slab_grow(struct slab_cache *cache)
+{
+	struct slab *slab = palloc_get_page(0);
+	if (slab == NULL)
+		return NULL;
+
+	slab->magic = SLAB_MAGIC;
+	slab->cache = cache;
+	slab->used = 0;
+	slab->free = NULL;
+	uint8_t *objs = (uint8_t *)(slab + 1);
+	for (size_t i = cache->per_slab; i > 0; i--)
+	{
+		void *obj = objs + (i - 1) * cache->obj_size;
+		*(void **)obj = slab->free;
+		slab->free = obj;
+	}
+	list_push_front(&cache->partial, &slab->elem);
+	cache->slab_cnt++;
+	cache->empty_cnt++;
+	return slab;
+}
+
+/* CACHE에서 객체 하나를 꺼냅니다. 내용은 초기화하지 않습니다. 메모리가 없으면 NULL.
+ * 폴트 경로와 회수 스레드가 함께 쓰므로 짧게 인터럽트를 끄고 다룹니다. */
+void *slab_alloc(struct slab_cache *cache)
+{
+	enum intr_level old_level = intr_disable();
+	struct slab *slab;
+	void *obj = NULL;
+
+	if (!list_empty(&cache->partial))
+		slab = list_entry(list_front(&cache->partial), struct slab, elem);
+	else
+		slab = slab_grow(cache);
+
+	if (slab != NULL)
+	{
+		obj = slab->free;
+		slab->free = *(void **)obj;
+		if (slab->used++ == 0)
+			cache->empty_cnt--;
+		if (slab->free == NULL)
+		{
+			list_remove(&slab->elem);
+			list_push_back(&cache->full, &slab->elem);
+		}
+		cache->active_cnt++;
+	}
+	intr_set_level(old_level);
+	return obj;
+}
+
+/* OBJ를 CACHE에 돌려줍니다. OBJ는 반드시 CACHE의 slab_alloc에서 나온 것이어야 합니다.
+ * 완전히 빈 슬랩은 하나만 남겨 두고 나머지는 커널 풀에 돌려줍니다. */
+void slab_free(struct slab_cache *cache, void *obj)
+{
+	if (obj == NULL)
+		return;
+
+	struct slab *slab = pg_round_down(obj);
+	ASSERT(slab->magic == SLAB_MAGIC && slab->cache == cache);
+
+	enum intr_level old_level = intr_disable();
+	if (slab->free == NULL)
+	{
+		list_remove(&slab->elem);
+		list_push_front(&cache->partial, &slab->elem);
+	}
+	*(void **)obj = slab->free;
+	slab->free = obj;
+	cache->active_cnt--;
+
+	bool release = false;
+	if (--slab->used == 0)
+	{
+		if (cache->empty_cnt > 0)
+		{
+			list_remove(&slab->elem);
+			cache->slab_cnt--;
+			release = true;
+		}
+		else
+			cache->empty_cnt++;
+	}
+	intr_set_level(old_level);
+
+	if (release)
+	{
+		slab->magic = 0;
+		palloc_free_page(slab);
+	}
+}
+
+/* 캐시마다 슬랩 수, 쓰는 객체 수, 빈 객체 수를 출력합니다. */
+void slab_print_stats(void)
+{
+	for (struct list_elem *e = list_begin(&caches); e != list_end(&caches); e = list_next(e))
+	{
+		struct slab_cache *cache = list_entry(e, struct slab_cache, elem);
+		printf("Slab %s: %zu slabs, %zu active, %zu free (%zu bytes each)\n",
+			   cache->name, cache->slab_cnt, cache->active_cnt,
+			   cache->slab_cnt * cache->per_slab - cache->active_cnt, cache->obj_size);
+	}
+}
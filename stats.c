@@ -0,0 +1,226 @@
+/* stats.c: 페이저 통계.
+ *
+ * 폴트 종류, 교체 결과, 스왑/write-back 횟수를 세고, 폴트 처리와 각 입출력 경로에 걸린 시간을
+ * 타이머 틱 단위의 로그 히스토그램으로 모읍니다. 전역 통계는 커널 전체의 것이고,
+ * 프로세스마다의 통계는 그 프로세스 문맥에서 일어난 일(그 프로세스의 폴트와, 그 폴트가 부른 교체)을 셉니다.
+ *
+ * 사용자 프로그램은 int 0x43으로 통계를 읽을 수 있습니다.
+ *   @RAX - 0이면 전역 통계, 1이면 호출한 프로세스의 통계
+ *   @RDI - struct vm_stats를 받을 사용자 버퍼
+ * 성공하면 RAX에 0, 버퍼가 잘못되었으면 -1을 돌려줍니다.
+ * */
+
+#include "vm/vm.h"
+#include "vm/stats.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "lib/round.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static struct vm_stats global_stats;
+
+static const char *stat_names[VM_STAT_CNT] = {
+	[VM_STAT_FAULT_MINOR] = "minor faults",
+	[VM_STAT_FAULT_MAJOR] = "major faults",
+	[VM_STAT_FAULT_ZERO] = "zero-page faults",
+	[VM_STAT_FAULT_COW] = "copy-on-write faults",
+	[VM_STAT_FAULT_CACHED] = "page cache hits",
+	[VM_STAT_FAULT_STACK] = "stack growth faults",
+	[VM_STAT_EVICT_SWAP] = "evictions to swap",
+	[VM_STAT_EVICT_FILE] = "evictions to file",
+	[VM_STAT_EVICT_CLEAN] = "clean evictions",
+	[VM_STAT_WRITEBACK] = "write-backs",
+	[VM_STAT_SECTOR_READ] = "sectors read",
+	[VM_STAT_SECTOR_WRITE] = "sectors written",
+};
+
+/* 벤치마크 보고 줄(vm-bench)의 키. 스크립트가 읽기 쉽도록 빈칸 없는 이름을 씁니다 */
+static const char *stat_keys[VM_STAT_CNT] = {
+	[VM_STAT_FAULT_MINOR] = "minor",
+	[VM_STAT_FAULT_MAJOR] = "major",
+	[VM_STAT_FAULT_ZERO] = "zero",
+	[VM_STAT_FAULT_COW] = "cow",
+	[VM_STAT_FAULT_CACHED] = "cached",
+	[VM_STAT_FAULT_STACK] = "stack",
+	[VM_STAT_EVICT_SWAP] = "evict_swap",
+	[VM_STAT_EVICT_FILE] = "evict_file",
+	[VM_STAT_EVICT_CLEAN] = "evict_clean",
+	[VM_STAT_WRITEBACK] = "writeback",
+	[VM_STAT_SECTOR_READ] = "sectors_read",
+	[VM_STAT_SECTOR_WRITE] = "sectors_written",
+};
+
+static const char *lat_names[VM_LAT_CNT] = {
+	[VM_LAT_FAULT_MINOR] = "minor fault",
+	[VM_LAT_FAULT_MAJOR] = "major fault",
+	[VM_LAT_SWAP_IN] = "swap in",
+	[VM_LAT_SWAP_OUT] = "swap out",
+	[VM_LAT_FILE_READ] = "file read",
+	[VM_LAT_WRITEBACK] = "write-back",
+};
+
+static const char *lat_keys[VM_LAT_CNT] = {
+	[VM_LAT_FAULT_MINOR] = "fault_minor",
+	[VM_LAT_FAULT_MAJOR] = "fault_major",
+	[VM_LAT_SWAP_IN] = "swap_in",
+	[VM_LAT_SWAP_OUT] = "swap_out",
+	[VM_LAT_FILE_READ] = "file_read",
+	[VM_LAT_WRITEBACK] = "writeback",
+};
+
+/* 현재 프로세스의 통계. 사용자 프로세스가 아니면(커널 스레드) NULL.
+ * 처음 기록할 때 만들고 supplemental_page_table_kill에서 돌려줍니다(exec하면 새로 셉니다). */
+static struct vm_stats *
+vm_stats_current(bool create)
+{
+	struct thread *cur = thread_current();
+
+	if (cur->pml4 == NULL)
+		return NULL;
+	if (cur->spt.stats == NULL && create)
+		cur->spt.stats = calloc(1, sizeof *cur->spt.stats);
+	return cur->spt.stats;
+}
+
+/* TICKS가 들어갈 히스토그램 칸. 0, 1, 2~3, 4~7, ... 처럼 두 배씩 넓어지고 마지막 칸이 나머지를 모두 받습니다. */
+static int
+vm_hist_bucket(int64_t ticks)
+{
+	int bucket = 0;
+
+	while (ticks > 0 && bucket < VM_HIST_BUCKETS - 1)
+	{
+		ticks >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/* 카운터 STAT에 CNT를 더합니다. 폴트 경로, 회수 스레드, 플러셔가 함께 쓰므로 짧게 인터럽트를 끕니다. */
+void vm_stat_add(enum vm_stat stat, unsigned cnt)
+{
+	struct vm_stats *proc = vm_stats_current(true);
+	enum intr_level old_level = intr_disable();
+
+	global_stats.cnt[stat] += cnt;
+	if (proc != NULL)
+		proc->cnt[stat] += cnt;
+	intr_set_level(old_level);
+}
+
+/* 경로 LAT이 TICKS만큼 걸린 것을 기록합니다. */
+void vm_stat_time(enum vm_lat lat, int64_t ticks)
+{
+	struct vm_stats *proc = vm_stats_current(true);
+	int bucket = vm_hist_bucket(ticks);
+	enum intr_level old_level = intr_disable();
+
+	global_stats.hist[lat][bucket]++;
+	global_stats.ticks[lat] += ticks;
+	if (proc != NULL)
+	{
+		proc->hist[lat][bucket]++;
+		proc->ticks[lat] += ticks;
+	}
+	intr_set_level(old_level);
+}
+
+/* 페이저가 디스크(스왑 디스크 또는 파일)에서 BYTES만큼 읽거나(WRITE가 false) 쓴 것을 섹터 수로 셉니다.
+ * 파일 쪽은 파일 시스템 캐시를 거치므로 실제 디스크 요청 수가 아니라 요청한 양입니다. */
+void vm_stat_io(bool write, size_t bytes)
+{
+	vm_stat_add(write ? VM_STAT_SECTOR_WRITE : VM_STAT_SECTOR_READ, DIV_ROUND_UP(bytes, DISK_SECTOR_SIZE));
+}
+
+/* 사용자 버퍼 [UADDR, UADDR + SIZE)가 모두 쓸 수 있는 사용자 페이지인지 확인합니다. */
+static bool
+user_buffer_writable(void *uaddr, size_t size)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *start = pg_round_down(uaddr);
+	uint8_t *end = (uint8_t *)uaddr + size;
+
+	if (uaddr == NULL || !is_user_vaddr(uaddr) || !is_user_vaddr(end - 1) || end < (uint8_t *)uaddr)
+		return false;
+	for (uint8_t *va = start; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (page == NULL || !page->writable)
+			return false;
+	}
+	return true;
+}
+
+static void
+vm_stats_query(struct intr_frame *f)
+{
+	struct vm_stats snapshot;
+	struct vm_stats *src = f->R.rax == 0 ? &global_stats : vm_stats_current(false);
+	void *ubuf = (void *)f->R.rdi;
+
+	if (f->R.rax > 1 || !user_buffer_writable(ubuf, sizeof snapshot))
+	{
+		f->R.rax = -1;
+		return;
+	}
+
+	/* 스냅숏을 뜬 뒤에 복사합니다. 사용자 버퍼에 쓰다가 폴트가 나면 통계가 바뀔 수 있습니다 */
+	enum intr_level old_level = intr_disable();
+	if (src != NULL)
+		snapshot = *src;
+	else
+		memset(&snapshot, 0, sizeof snapshot);
+	intr_set_level(old_level);
+
+	memcpy(ubuf, &snapshot, sizeof snapshot);
+	f->R.rax = 0;
+}
+
+void vm_stats_init(void)
+{
+	intr_register_int(0x43, 3, INTR_ON, vm_stats_query, "VM Statistics");
+}
+
+/* 프로세스 통계를 돌려줍니다. */
+void vm_stats_free(struct supplemental_page_table *spt)
+{
+	free(spt->stats);
+	spt->stats = NULL;
+}
+
+/* 전역 통계를 출력합니다. 커널 종료 시 print_stats()에서 부릅니다.
+ * 첫 줄(vm-bench)은 벤치마크 스크립트가 기준 커널과 비교할 수 있도록 모든 값을 key=value 한 줄로 담습니다. */
+void vm_stats_print(void)
+{
+	printf("vm-bench: ticks=%"PRId64, timer_ticks());
+	for (int i = 0; i < VM_STAT_CNT; i++)
+		printf(" %s=%u", stat_keys[i], global_stats.cnt[i]);
+	for (int i = 0; i < VM_LAT_CNT; i++)
+		printf(" %s_ticks=%"PRId64, lat_keys[i], global_stats.ticks[i]);
+	printf("\n");
+
+	printf("VM:");
+	for (int i = 0; i < VM_STAT_CNT; i++)
+		printf("%s %u %s", i == 0 ? "" : ",", global_stats.cnt[i], stat_names[i]);
+	printf("\n");
+
+	for (int i = 0; i < VM_LAT_CNT; i++)
+	{
+		unsigned total = 0;
+		for (int b = 0; b < VM_HIST_BUCKETS; b++)
+			total += global_stats.hist[i][b];
+		if (total == 0)
+			continue;
+
+		printf("VM latency %s: %u calls, %"PRId64" ticks, histogram", lat_names[i], total, global_stats.ticks[i]);
+		for (int b = 0; b < VM_HIST_BUCKETS; b++)
+			printf(" %u", global_stats.hist[i][b]);
+		printf("\n");
+	}
+}
@@ -3,3 +3,7 @@ vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
 vm_SRC += vm/inspect.c    # Testing utility
+vm_SRC += vm/slab.c       # Object caches for VM metadata
+vm_SRC += vm/page_cache.c # Shared cache of file-backed frames
+vm_SRC += vm/stats.c      # Pager statistics
+vm_SRC += vm/trace.c      # Page-fault trace ring
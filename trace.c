@@ -0,0 +1,100 @@
+/* trace.c: 페이지 폴트 추적 링 버퍼.
+ *
+ * 폴트, 교체, 스왑 입출력이 일어날 때마다 (틱, 스레드, 사건, 가상 주소, 플래그)를 고정 크기 링에 남깁니다.
+ * 나중에 이 기록을 그대로 다른 교체/미리 읽기 정책에 다시 흘려 볼 수 있습니다.
+ *
+ * Pintos는 CPU가 하나이므로 CPU별 링은 하나뿐이고, 기록은 인터럽트를 끈 채 칸 하나를 차지하는 것으로 끝납니다.
+ * 락을 잡지 않으므로 폴트 경로 어디서든, 인터럽트 문맥에서도 부를 수 있습니다.
+ * 링이 차면 가장 오래된 기록부터 덮어씁니다.
+ *
+ * VM_TRACE를 정의하고 빌드했을 때만 컴파일됩니다(Make.vars.debug 등). 정의하지 않으면
+ * vm/trace.h의 vm_trace()와 vm_trace_dump()는 아무 코드도 만들지 않는 매크로입니다.
+ * */
+
+#include "vm/trace.h"
+
+#ifdef VM_TRACE
+
+#include "vm/vm.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include <debug.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+/* 기록 칸 수. 2의 거듭제곱이어야 합니다 */
+#define TRACE_SIZE 2048
+
+struct trace_entry {
+	int64_t tick;
+	void *va;
+	tid_t tid;
+	int arg;				/* 스왑 슬롯 등 사건마다의 값. 없으면 -1 */
+	uint8_t event;			/* enum vm_trace_event */
+	uint8_t flags;			/* VM_TRACE_WRITE 등 */
+};
+
+static struct trace_entry *trace_ring;
+static uint64_t trace_head;		/* 지금까지 기록한 수. 다음 칸은 trace_head % TRACE_SIZE */
+
+static const char *event_names[] = {
+	[VM_TRACE_FAULT] = "fault",
+	[VM_TRACE_STACK] = "stack",
+	[VM_TRACE_EVICT] = "evict",
+	[VM_TRACE_SWAP_OUT] = "swap-out",
+	[VM_TRACE_SWAP_IN] = "swap-in",
+};
+
+void vm_trace_init(void)
+{
+	size_t pages = (TRACE_SIZE * sizeof *trace_ring + PGSIZE - 1) / PGSIZE;
+	trace_ring = palloc_get_multiple(PAL_ZERO, pages);
+	if (trace_ring == NULL)
+		printf("vm-trace: no memory for %d entries, tracing disabled\n", TRACE_SIZE);
+}
+
+void vm_trace_record(enum vm_trace_event event, void *va, unsigned flags, int arg)
+{
+	if (trace_ring == NULL)
+		return;
+
+	enum intr_level old_level = intr_disable();
+	struct trace_entry *entry = &trace_ring[trace_head++ & (TRACE_SIZE - 1)];
+	intr_set_level(old_level);
+
+	/* 칸은 이미 차지했으므로 나머지는 인터럽트를 켠 채 채웁니다. 덤프 도중이면 한 칸이 반쯤 보일 수 있습니다 */
+	entry->tick = timer_ticks();
+	entry->va = va;
+	entry->tid = thread_current()->tid;
+	entry->arg = arg;
+	entry->event = event;
+	entry->flags = flags;
+}
+
+/* 링에 남은 기록 중 스레드 TID의 것을 오래된 순으로 콘솔에 출력합니다. TID가 TID_ERROR면 모두 출력합니다.
+ * 한 줄이 기록 하나이고, 빈칸으로 나뉜 필드는 tick tid event va flags arg 순입니다. */
+void vm_trace_dump(tid_t tid)
+{
+	if (trace_ring == NULL)
+		return;
+
+	uint64_t head = trace_head;
+	uint64_t first = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+
+	for (uint64_t i = first; i < head; i++)
+	{
+		const struct trace_entry *entry = &trace_ring[i & (TRACE_SIZE - 1)];
+		if (tid != TID_ERROR && entry->tid != tid)
+			continue;
+		printf("vm-trace %"PRId64" %d %s %p %c%c%c %d\n", entry->tick, entry->tid, event_names[entry->event],
+			   entry->va,
+			   entry->flags & VM_TRACE_WRITE ? 'w' : 'r',
+			   entry->flags & VM_TRACE_NOT_PRESENT ? 'n' : 'p',
+			   entry->flags & VM_TRACE_USER ? 'u' : 'k',
+			   entry->arg);
+	}
+}
+
+#endif /* VM_TRACE */
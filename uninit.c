@@ -9,6 +9,7 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "vm/slab.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -63,8 +64,7 @@ static void
 uninit_destroy (struct page *page) {
 	struct file_info *aux = (struct file_info *)page->uninit.aux;
     if (aux != NULL) {
-        file_close(aux->file);  // 파일 핸들 닫기
-        free(aux);              // aux 메모리 해제
+        file_info_free(aux);    // 파일 핸들(또는 매핑 서술자 참조)과 aux 메모리 해제
     }
 	return;
 }
\ No newline at end of file
@@ -3,11 +3,121 @@
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/slab.h"
+#include "vm/page_cache.h"
+#include "vm/stats.h"
+#include "vm/trace.h"
 #include "threads/mmu.h"
 #include "userprog/process.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/interrupt.h"
+#include "lib/kernel/hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
 #define STACK_GROW_RANGE 4192
 struct frame_table *frame_table;
 
+/* 교체 정책. page_operations 처럼 정책마다 함수 테이블을 하나씩 두고,
+ * 부팅 시 커널 커맨드라인(-vm-policy=NAME)으로 고릅니다.
+ *  insert: 프레임이 페이지와 연결되어 교체 후보가 될 때
+ *  touch:  폴트 처리 중에 이미 올라와 있는 프레임이 다시 참조된 것을 알았을 때
+ *  victim: 희생 프레임을 골라 정책의 자료구조에서 빼고 반환 (고를 게 없으면 NULL)
+ *  remove: 프레임이 해제되어 후보에서 빠질 때 */
+struct evict_policy {
+	const char *name;
+	void (*init)(void);
+	void (*insert)(struct frame *frame);
+	void (*touch)(struct frame *frame);
+	struct frame *(*victim)(void);
+	void (*remove)(struct frame *frame);
+	void (*evicted)(struct frame *frame);	/* victim()이 고른 프레임을 실제로 내보냈을 때(없어도 됨) */
+};
+
+static const struct evict_policy fifo_policy;
+static const struct evict_policy clock_policy;
+static const struct evict_policy aging_policy;
+static const struct evict_policy twoq_policy;
+
+static const struct evict_policy *evict_policies[] = {
+	&fifo_policy, &clock_policy, &aging_policy, &twoq_policy,
+};
+static const struct evict_policy *evict_policy = &clock_policy;
+
+/* -vm-swap-bench: 부팅 때 스왑 슬롯 할당기 벤치마크를 돌립니다 */
+static bool swap_bench;
+/* -vm-spt-bench: 부팅 때 기수 트리 SPT와 해시 SPT를 비교합니다 */
+static bool spt_bench;
+/* -vm-trace-dump: 프로세스가 주소 공간을 없앨 때 그 프로세스의 폴트 추적 기록을 출력합니다(VM_TRACE 빌드) */
+static bool trace_dump;
+static void spt_run_bench(void);
+
+/* 백그라운드 회수(reclaim). 남은 사용자 프레임이 reclaim_low 아래로 떨어지면 회수 스레드가 깨어나
+ * reclaim_high에 닿을 때까지 페이지를 내보내고, 비운 프레임은 ready_frames에 쌓아 둡니다.
+ * vm_get_frame은 palloc이 실패하면 여기서 O(1)에 하나를 꺼내 쓰고, 이마저 비었을 때만 직접 교체합니다.
+ * 워터마크는 -vm-reclaim-low=N, -vm-reclaim-high=N(프레임 수)로 바꿀 수 있고 low가 0이면 스레드를 띄우지 않습니다. */
+#define RECLAIM_LOW_DEFAULT(FRAMES) ((FRAMES) / 64 > 4 ? (FRAMES) / 64 : 4)
+
+static struct lock evict_lock;			/* 교체(vm_evict_frame)를 한 번에 하나씩만 하도록 */
+static struct semaphore reclaim_sema;	/* 회수 스레드를 깨웁니다 */
+static struct list ready_frames;		/* 회수 스레드가 비워 둔 프레임(frame_elem으로 연결) */
+static size_t ready_cnt;
+static size_t frame_alloc_cnt;			/* palloc에서 받아 아직 돌려주지 않은 사용자 프레임 수 */
+static size_t reclaim_low, reclaim_high;
+static bool reclaim_low_set, reclaim_high_set;
+static bool reclaim_running;
+
+static void reclaim_start(void);
+
+/* 미리 0으로 채운 프레임 풀. 가장 낮은 우선순위의 스레드가 다른 할 일이 없을 때 빈 사용자 프레임을
+ * 0으로 채워 zero_frames에 쌓아 두고, 0 채움 폴트(스택, 처음 쓰는 익명 페이지)는 여기서 꺼내 memset을 건너뜁니다.
+ * 풀 크기는 -vm-zero-pool=N(프레임 수)으로 바꾸고 0이면 스레드를 띄우지 않습니다. */
+#define ZERO_POOL_DEFAULT(FRAMES) ((FRAMES) / 128 > 8 ? (FRAMES) / 128 : 8)
+
+static struct list zero_frames;			/* 0으로 채운 프레임(frame_elem으로 연결) */
+static size_t zero_cnt;
+static size_t zero_target;
+static bool zero_target_set;
+static struct semaphore zero_sema;		/* 풀이 줄었을 때 채우는 스레드를 깨웁니다 */
+static bool zero_running;
+
+static void zero_pool_start(void);
+
+/* 플러셔. flush_interval 틱마다 파일 기반 프레임을 훑어 더럽혀진 것을 미리 파일에 써 둡니다.
+ * 교체나 munmap이 그 페이지에 닿을 때는 대개 이미 깨끗하므로 매핑만 끊으면 됩니다.
+ * -vm-flush-interval=TICKS로 주기를 바꾸고, 0이면 스레드를 띄우지 않습니다. */
+#define FLUSH_INTERVAL_DEFAULT TIMER_FREQ
+
+static int64_t flush_interval = FLUSH_INTERVAL_DEFAULT;
+static struct frame *flushing;			/* 플러셔가 evict_lock 없이 쓰고 있는 프레임. 없으면 NULL */
+static struct condition flush_cond;		/* flushing이 NULL이 될 때 알립니다(evict_lock과 함께 씁니다) */
+
+static void flusher_start(void);
+static void aging_start(void);
+
+/* 역매핑(rmap) 항목. 프레임 하나를 여러 주소 공간이 공유할 수 있으므로(fork 후 COW)
+ * 프레임마다 자신을 매핑한 (pml4, va, page)를 모두 기록해 두고, 교체할 때 전부 끊습니다. */
+struct frame_map {
+	uint64_t *pml4;
+	struct supplemental_page_table *spt;	/* 교체 시 같은 주소 공간의 이웃 페이지를 찾는 데 씁니다 */
+	void *va;
+	struct page *page;
+	struct list_elem map_elem;
+};
+
+/* VM 메타데이터 캐시. 폴트 경로의 할당이 malloc 대신 슬랩의 빈 리스트에서 포인터 하나를 꺼내는 것으로 끝납니다.
+ * struct frame은 프레임 테이블 배열에 미리 있으므로 캐시가 필요 없습니다.
+ * struct page는 템플릿의 vm_dealloc_page가 free로 돌려주므로 malloc으로 만듭니다. */
+struct slab_cache file_info_slab;
+static struct slab_cache frame_map_slab;
+
+/* 한 번도 쓰지 않은 익명 페이지를 읽을 때 모두가 읽기 전용으로 공유하는 0으로 찬 프레임.
+ * 커널 풀에서 할당하므로 프레임 테이블에도, 교체 정책에도 들어가지 않습니다. */
+static struct frame zero_frame;
+
 /* 각 서브시스템의 초기화 코드를 호출하여 가상 메모리 서브시스템을 초기화합니다. */
 void vm_init(void)
 {
@@ -20,7 +130,20 @@ void vm_init(void)
 	/* 이 위쪽은 수정하지 마세요 !! */
 	/* TODO: 이 아래쪽부터 코드를 추가하세요 */
 
+	slab_cache_init(&file_info_slab, "file_info", sizeof(struct file_info));
+	slab_cache_init(&frame_map_slab, "frame_map", sizeof(struct frame_map));
 	frame_table_init();
+	vm_pagecache_init();
+	vm_stats_init();
+	vm_trace_init();
+	reclaim_start();
+	zero_pool_start();
+	flusher_start();
+	aging_start();
+	if (swap_bench)
+		anon_swap_bench();
+	if (spt_bench)
+		spt_run_bench();
 }
 
 /* 페이지의 타입을 가져옵니다. 이 함수는 페이지가 초기화된 후 타입을 알고 싶을 때 유용합니다.
@@ -38,216 +161,2140 @@ page_get_type(struct page *page)
 	}
 }
 
+/* 사용자 풀의 시작 주소. 프레임 번호는 (kva - user_pool_base) >> PGBITS 입니다. */
+static uint8_t *user_pool_base;
+
+/* 사용자 풀의 범위를 알아냅니다. palloc은 풀 경계를 밖으로 알려주지 않으므로
+ * 부팅 시 한 번 사용자 풀을 전부 할당해 가장 낮은/높은 주소를 기록한 뒤 돌려줍니다.
+ * 할당받은 페이지들은 각 페이지 첫 8바이트에 다음 페이지 주소를 적어 엮어 둡니다. */
+static size_t
+user_pool_probe(void)
+{
+	void *head = NULL;
+	uint8_t *lo = NULL, *hi = NULL;
+	uint8_t *kva;
+
+	while ((kva = palloc_get_page(PAL_USER)) != NULL)
+	{
+		*(void **)kva = head;
+		head = kva;
+		if (lo == NULL || kva < lo)
+			lo = kva;
+		if (hi == NULL || kva > hi)
+			hi = kva;
+	}
+	while (head != NULL)
+	{
+		void *next = *(void **)head;
+		palloc_free_page(head);
+		head = next;
+	}
+
+	user_pool_base = lo;
+	return lo != NULL ? (size_t)(hi - lo) / PGSIZE + 1 : 0;
+}
+
+/* 프레임 테이블을 사용자 풀 전체를 덮는 배열로 미리 만들어 둡니다.
+ * 폴트 경로에서는 프레임 구조체를 malloc/free 하지 않고 프레임 번호로 바로 찾아 씁니다. */
 void frame_table_init(){
 	frame_table = malloc(sizeof(struct frame_table));
+	ASSERT(frame_table != NULL);
 	list_init(&frame_table->frame_list);
+
+	frame_table->frame_cnt = user_pool_probe();
+	frame_table->frames = calloc(frame_table->frame_cnt, sizeof *frame_table->frames);
+	ASSERT(frame_table->frame_cnt == 0 || frame_table->frames != NULL);
+	for (size_t i = 0; i < frame_table->frame_cnt; i++)
+	{
+		frame_table->frames[i].kva = user_pool_base + i * PGSIZE;
+		list_init(&frame_table->frames[i].maps);
+	}
+
+	evict_policy->init();
+
+	zero_frame.kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	list_init(&zero_frame.maps);
+	zero_frame.pinned = true;
+}
+
+/* KVA(사용자 풀 페이지)를 담당하는 프레임 구조체를 O(1)에 찾습니다. */
+struct frame *
+frame_table_lookup(void *kva)
+{
+	size_t idx = ((uint8_t *)kva - user_pool_base) >> PGBITS;
+
+	ASSERT((uint8_t *)kva >= user_pool_base);
+	ASSERT(idx < frame_table->frame_cnt);
+	return &frame_table->frames[idx];
+}
+
+/* 커널 커맨드라인의 VM 옵션을 처리합니다. threads/init.c 의 parse_options()가
+ * 모르는 옵션을 여기로 넘기며, 처리한 옵션이면 true를 반환합니다.
+ * vm_init()보다 먼저 불리므로 값만 기록해 둡니다. */
+bool vm_parse_option(const char *name, const char *value)
+{
+	if (!strcmp(name, "-vm-policy"))
+	{
+		for (size_t i = 0; i < sizeof evict_policies / sizeof *evict_policies; i++)
+			if (value != NULL && !strcmp(value, evict_policies[i]->name))
+			{
+				evict_policy = evict_policies[i];
+				return true;
+			}
+		PANIC("unknown eviction policy `%s' (fifo, clock, aging, 2q)", value);
+	}
+	if (!strcmp(name, "-vm-reclaim-low") || !strcmp(name, "-vm-reclaim-high"))
+	{
+		if (value == NULL)
+			PANIC("%s needs a frame count", name);
+		if (!strcmp(name, "-vm-reclaim-low"))
+		{
+			reclaim_low = atoi(value);
+			reclaim_low_set = true;
+		}
+		else
+		{
+			reclaim_high = atoi(value);
+			reclaim_high_set = true;
+		}
+		return true;
+	}
+	if (!strcmp(name, "-vm-zero-pool"))
+	{
+		if (value == NULL)
+			PANIC("%s needs a frame count", name);
+		zero_target = atoi(value);
+		zero_target_set = true;
+		return true;
+	}
+	if (!strcmp(name, "-vm-flush-interval"))
+	{
+		if (value == NULL)
+			PANIC("%s needs a tick count", name);
+		flush_interval = atoi(value);
+		return true;
+	}
+	if (!strcmp(name, "-vm-swap-bench"))
+	{
+		swap_bench = true;
+		return true;
+	}
+	if (!strcmp(name, "-vm-spt-bench"))
+	{
+		spt_bench = true;
+		return true;
+	}
+	if (!strcmp(name, "-vm-trace-dump"))
+	{
+		trace_dump = true;
+		return true;
+	}
+	return false;
+}
+
+/* FRAME의 역매핑에서 PAGE의 항목을 찾습니다. */
+static struct frame_map *
+frame_find_map(struct frame *frame, struct page *page)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		if (map->page == page)
+			return map;
+	}
+	return NULL;
+}
+
+/* 현재 스레드의 주소 공간에서 PAGE가 FRAME을 매핑한다고 역매핑에 기록합니다.
+ * 프레임의 첫 매핑이면 교체 후보로도 등록합니다. 역매핑과 교체 후보 목록은 교체가 함께 훑으므로
+ * evict_lock을 잡은 채 불러야 합니다. */
+void frame_map_add(struct frame *frame, struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&evict_lock));
+
+	struct frame_map *map = slab_alloc(&frame_map_slab);
+	ASSERT(map != NULL);
+
+	map->pml4 = thread_current()->pml4;
+	map->spt = &thread_current()->spt;
+	map->va = page->va;
+	map->page = page;
+	list_push_back(&frame->maps, &map->map_elem);
+	page->frame = frame;
+	if (frame->r_cnt++ == 0)
+	{
+		frame->page = page;
+		evict_policy->insert(frame);
+	}
+}
+
+/* 새로 구한 프레임을 페이지와 연결하고 교체 후보로 등록합니다.
+ * 등록하자마자 회수 스레드가 고를 수 있으므로 고정해서 넣고, 호출자는 매핑(pml4_set_page)을 마친 뒤 고정을 풉니다. */
+static void
+frame_table_insert(struct frame *frame, struct page *page)
+{
+	ASSERT(frame->r_cnt == 0);
+	frame->pinned = true;
+	lock_acquire(&evict_lock);
+	frame_map_add(frame, page);
+	lock_release(&evict_lock);
+}
+
+/* PAGE를 자신의 프레임 역매핑에서 빼고 연결을 끊습니다. 페이지 테이블 항목은 호출자가 정리합니다.
+ * 마지막 매핑이었다면 프레임을 풀에 돌려주고, 아니면 남은 매핑 중 하나를 대표 페이지로 삼습니다.
+ * 교체와 겹치지 않도록 evict_lock(frame_table_lock)을 잡은 채 불러야 합니다. */
+void frame_table_unlink(struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&evict_lock));
+
+	struct frame *frame = page->frame;
+	if (frame == NULL)
+		return;
+	if (frame == &zero_frame)
+	{
+		page->frame = NULL;
+		return;
+	}
+
+	struct frame_map *map = frame_find_map(frame, page);
+	if (map != NULL)
+	{
+		list_remove(&map->map_elem);
+		slab_free(&frame_map_slab, map);
+		frame->r_cnt--;
+	}
+	page->frame = NULL;
+
+	if (list_empty(&frame->maps))
+		frame_table_free(frame);
+	else if (frame->page == page)
+		frame->page = list_entry(list_front(&frame->maps), struct frame_map, map_elem)->page;
+}
+
+/* 고정된 채 PAGE와 연결했지만 매핑(pml4_set_page)하지 못한 프레임을 풀고 PAGE의 연결을 끊습니다.
+ * 페이지 테이블을 만들 메모리가 없는 경우라 폴트 경로는 그대로 false를 돌려 프로세스를 끝냅니다. */
+static bool
+vm_map_failed(struct page *page)
+{
+	lock_acquire(&evict_lock);
+	page->frame->pinned = false;
+	frame_table_unlink(page);
+	lock_release(&evict_lock);
+	return false;
+}
+
+/* 현재 주소 공간에 VA를 매핑할 페이지 테이블을 미리 만들어 둡니다. 성공하면 같은 VA의 pml4_set_page는 실패하지 않습니다.
+ * 내용을 채워 타입을 바꾸고 나면 되돌릴 수 없는 경로에서, 바꾸기 전에 실패하게 하려고 씁니다. */
+static bool
+vm_reserve_pte(void *va)
+{
+	return pml4e_walk(thread_current()->pml4, (uint64_t)va, 1) != NULL;
+}
+
+/* 프레임을 매핑한 주소 공간 중 한 곳이라도 참조/수정했는지 확인합니다. */
+bool frame_is_accessed(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		if (pml4_is_accessed(map->pml4, map->va))
+			return true;
+	}
+	return false;
+}
+
+bool frame_is_dirty(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		if (pml4_is_dirty(map->pml4, map->va))
+			return true;
+	}
+	return false;
+}
+
+void frame_clear_accessed(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		pml4_set_accessed(map->pml4, map->va, false);
+	}
+}
+
+void frame_clear_dirty(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		pml4_set_dirty(map->pml4, map->va, false);
+	}
+}
+
+/* 프레임을 교체 후보에서 뺍니다. 프레임을 해제하기 전에 반드시 불러야 합니다. */
+void frame_table_remove(struct frame *frame)
+{
+	evict_policy->remove(frame);
+}
+
+/* 더 이상 아무 페이지도 쓰지 않는 프레임을 교체 후보에서 빼고 사용자 풀에 돌려줍니다.
+ * 프레임 구조체는 테이블 배열의 일부이므로 free 하지 않고 비워 두기만 합니다. */
+void frame_table_free(struct frame *frame)
+{
+	ASSERT(list_empty(&frame->maps));
+
+	frame_table_remove(frame);
+	vm_pagecache_forget(frame);
+	frame->page = NULL;
+	frame->r_cnt = 0;
+	frame->pinned = false;
+	palloc_free_page(frame->kva);
+	frame_alloc_cnt--;
+}
+
+/* 교체 대상이 될 수 있는 프레임인지 확인합니다. 공유 프레임도 역매핑으로 모든 매핑을 끊을 수 있으므로 후보입니다.
+ * 내용을 채우거나 복사하는 중인 프레임(pinned)은 건너뜁니다. */
+static bool
+frame_evictable(struct frame *frame)
+{
+	return frame->page != NULL && !frame->pinned && !list_empty(&frame->maps);
+}
+
+/* FIFO: 들어온 순서대로 frame_list 앞에서부터 내보냅니다. */
+static void
+fifo_init(void)
+{
+}
+
+static void
+fifo_insert(struct frame *frame)
+{
+	list_push_back(&frame_table->frame_list, &frame->frame_elem);
+}
+
+static void
+fifo_touch(struct frame *frame UNUSED)
+{
+}
+
+static struct frame *
+fifo_victim(void)
+{
+	struct list *frames = &frame_table->frame_list;
+
+	for (struct list_elem *e = list_begin(frames); e != list_end(frames); e = list_next(e))
+	{
+		struct frame *frame = list_entry(e, struct frame, frame_elem);
+		if (frame_evictable(frame))
+		{
+			list_remove(e);
+			return frame;
+		}
+	}
+	return NULL;
+}
+
+static void
+fifo_remove(struct frame *frame)
+{
+	list_remove(&frame->frame_elem);
+}
+
+static const struct evict_policy fifo_policy = {
+	.name = "fifo",
+	.init = fifo_init,
+	.insert = fifo_insert,
+	.touch = fifo_touch,
+	.victim = fifo_victim,
+	.remove = fifo_remove,
+};
+
+/* clock 교체 정책의 시계 바늘. 프레임 배열을 원형으로 돌면서 다음에 검사할 프레임 번호를 가리킵니다.
+ * 페이지가 연결된 프레임이 곧 후보이므로 따로 목록을 두지 않습니다. */
+static size_t clock_hand;
+
+static void
+clock_init(void)
+{
+	clock_hand = 0;
+}
+
+static void
+clock_insert(struct frame *frame UNUSED)
+{
+}
+
+/* 시계 바늘이 가리키는 프레임을 돌려주고 바늘을 한 칸 전진시킵니다. 배열 끝에 닿으면 처음으로 돌아갑니다. */
+static struct frame *
+clock_advance(void)
+{
+	struct frame *frame = &frame_table->frames[clock_hand];
+
+	if (++clock_hand >= frame_table->frame_cnt)
+		clock_hand = 0;
+	return frame;
+}
+
+static void
+clock_remove(struct frame *frame UNUSED)
+{
+}
+
+/* enhanced second-chance(clock) 정책으로 희생 프레임을 고릅니다.
+ * (accessed, dirty) 가 (0,0) -> (0,1) 순서로 우선이고, (0,1)을 찾는 바퀴에서는
+ * 지나가는 프레임의 accessed 비트를 지웁니다. 그래서 최대 네 바퀴 안에 반드시 희생자가 나옵니다. */
+static struct frame *
+clock_victim(void)
+{
+	size_t frame_cnt = frame_table->frame_cnt;
+
+	for (int round = 0; round < 4; round++)
+	{
+		bool want_dirty = round % 2 == 1;
+		for (size_t i = 0; i < frame_cnt; i++)
+		{
+			struct frame *frame = clock_advance();
+			if (!frame_evictable(frame))
+				continue;
+
+			bool accessed = frame_is_accessed(frame);
+			bool dirty = frame_is_dirty(frame);
+
+			if (!accessed && dirty == want_dirty)
+			{
+				clock_remove(frame);
+				return frame;
+			}
+			if (want_dirty)
+				frame_clear_accessed(frame);
+		}
+	}
+	return NULL;
+}
+
+static const struct evict_policy clock_policy = {
+	.name = "clock",
+	.init = clock_init,
+	.insert = clock_insert,
+	.touch = fifo_touch,
+	.victim = clock_victim,
+	.remove = clock_remove,
+};
+
+/* aging: 프레임마다 8비트 나이를 두고, AGING_INTERVAL 틱마다 accessed 비트를
+ * 최상위 비트로 밀어 넣어 LRU를 근사합니다. 타이머 인터럽트 안에서 프레임 목록과 역매핑을
+ * 훑지 않도록 aging 스레드가 AGING_INTERVAL마다 깨어나 evict_lock을 잡고 나이를 밉니다.
+ * 스레드가 늦게 깨어났으면 정책이 호출될 때 지난 주기 수만큼 한꺼번에 따라잡습니다. */
+#define AGING_INTERVAL (TIMER_FREQ / 10)
+
+static int64_t aging_last_tick;
+
+static void
+aging_init(void)
+{
+	aging_last_tick = timer_ticks();
+}
+
+static void
+aging_update(void)
+{
+	int64_t epochs = (timer_ticks() - aging_last_tick) / AGING_INTERVAL;
+	if (epochs <= 0)
+		return;
+	aging_last_tick += epochs * AGING_INTERVAL;
+	if (epochs > 8)
+		epochs = 8;
+
+	for (size_t i = 0; i < frame_table->frame_cnt; i++)
+	{
+		struct frame *frame = &frame_table->frames[i];
+		uint8_t ref = 0;
+
+		if (!frame_evictable(frame))
+			continue;
+		if (frame_is_accessed(frame))
+		{
+			ref = 0x80;
+			frame_clear_accessed(frame);
+		}
+		frame->age = ((frame->age >> 1) | ref) >> (epochs - 1);
+	}
+}
+
+/* aging 스레드. 교체가 없는 동안에도 주기마다 accessed 비트를 나이에 옮겨, 주기 사이의 접근이
+ * 다음 교체 때 한 번의 시프트로 뭉개지지 않게 합니다. */
+static void
+aging_thread(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_sleep(AGING_INTERVAL);
+		lock_acquire(&evict_lock);
+		aging_update();
+		lock_release(&evict_lock);
+	}
+}
+
+/* aging 정책일 때만 aging 스레드를 띄웁니다. evict_lock을 초기화한 reclaim_start() 다음에 불러야 합니다. */
+static void
+aging_start(void)
+{
+	if (evict_policy == &aging_policy)
+		thread_create("aging", PRI_DEFAULT, aging_thread, NULL);
+}
+
+static void
+aging_insert(struct frame *frame)
+{
+	aging_update();
+	/* 방금 들어온 프레임은 가장 최근에 쓰인 것으로 봅니다 */
+	frame->age = 0x80;
+}
+
+static void
+aging_touch(struct frame *frame)
+{
+	frame->age |= 0x80;
+}
+
+/* 나이가 가장 작은 프레임을 고르고, 같으면 깨끗한 프레임을 먼저 고릅니다. */
+static struct frame *
+aging_victim(void)
+{
+	struct frame *victim = NULL;
+	bool victim_dirty = false;
+
+	aging_update();
+	for (size_t i = 0; i < frame_table->frame_cnt; i++)
+	{
+		struct frame *frame = &frame_table->frames[i];
+		if (!frame_evictable(frame))
+			continue;
+
+		bool dirty = frame_is_dirty(frame);
+		if (victim == NULL || frame->age < victim->age
+			|| (frame->age == victim->age && victim_dirty && !dirty))
+		{
+			victim = frame;
+			victim_dirty = dirty;
+		}
+	}
+	return victim;
+}
+
+static const struct evict_policy aging_policy = {
+	.name = "aging",
+	.init = aging_init,
+	.insert = aging_insert,
+	.touch = aging_touch,
+	.victim = aging_victim,
+	.remove = clock_remove,
+};
+
+/* 2Q: 처음 들어온 프레임은 A1in(FIFO, frame_list)에 두고, A1in에서 쫓겨난 페이지는
+ * A1out(유령 목록)에 기록만 해 둡니다. 유령 목록에 있는 페이지가 다시 들어오면
+ * 자주 쓰이는 페이지로 보고 Am(second-chance LRU, am_list)에 넣습니다.
+ * 한 번 훑고 지나가는 접근이 자주 쓰이는 페이지를 밀어내지 못하게 합니다. */
+#define TWOQ_GHOST_CNT 256
+
+enum twoq_queue { TWOQ_A1IN, TWOQ_AM };
+
+static struct list am_list;
+static size_t a1in_cnt, am_cnt;
+/* 유령은 (주소 공간, 가상 주소)로 기억합니다. struct page는 해제되면 슬랩에서 곧 다른 페이지로 다시 쓰이므로
+ * 포인터를 키로 삼으면 새 페이지가 유령으로 잘못 걸립니다. */
+struct twoq_ghost {
+	struct supplemental_page_table *spt;
+	void *va;
+};
+
+static struct twoq_ghost twoq_ghosts[TWOQ_GHOST_CNT];
+static size_t twoq_ghost_next;
+
+static void
+twoq_init(void)
+{
+	list_init(&am_list);
+	a1in_cnt = am_cnt = 0;
+	twoq_ghost_next = 0;
+}
+
+/* FRAME을 처음 매핑한 곳(대표 페이지의 주소 공간과 주소)을 유령 키로 돌려줍니다. */
+static struct twoq_ghost
+twoq_ghost_key(struct frame *frame)
+{
+	struct frame_map *map = list_entry(list_front(&frame->maps), struct frame_map, map_elem);
+	return (struct twoq_ghost) { .spt = map->spt, .va = map->va };
+}
+
+/* 유령 목록에서 FRAME의 키를 찾아 지웁니다. 있었으면 true. */
+static bool
+twoq_ghost_take(struct frame *frame)
+{
+	struct twoq_ghost key = twoq_ghost_key(frame);
+
+	for (size_t i = 0; i < TWOQ_GHOST_CNT; i++)
+		if (twoq_ghosts[i].spt == key.spt && twoq_ghosts[i].va == key.va)
+		{
+			twoq_ghosts[i] = (struct twoq_ghost) { NULL, NULL };
+			return true;
+		}
+	return false;
+}
+
+/* 없어지는 주소 공간 SPT의 유령을 지웁니다. 같은 자리에 새 프로세스가 생겨도 유령으로 걸리지 않게 합니다. */
+static void
+twoq_ghost_forget(struct supplemental_page_table *spt)
+{
+	for (size_t i = 0; i < TWOQ_GHOST_CNT; i++)
+		if (twoq_ghosts[i].spt == spt)
+			twoq_ghosts[i] = (struct twoq_ghost) { NULL, NULL };
+}
+
+static void
+twoq_insert(struct frame *frame)
+{
+	if (twoq_ghost_take(frame))
+	{
+		frame->queue = TWOQ_AM;
+		list_push_back(&am_list, &frame->frame_elem);
+		am_cnt++;
+	}
+	else
+	{
+		frame->queue = TWOQ_A1IN;
+		list_push_back(&frame_table->frame_list, &frame->frame_elem);
+		a1in_cnt++;
+	}
+}
+
+static void
+twoq_touch(struct frame *frame)
+{
+	if (frame->queue == TWOQ_AM)
+	{
+		list_remove(&frame->frame_elem);
+		list_push_back(&am_list, &frame->frame_elem);
+	}
+}
+
+static void
+twoq_remove(struct frame *frame)
+{
+	list_remove(&frame->frame_elem);
+	if (frame->queue == TWOQ_AM)
+		am_cnt--;
+	else
+		a1in_cnt--;
+}
+
+static struct frame *
+twoq_victim_a1in(void)
+{
+	struct list *frames = &frame_table->frame_list;
+
+	for (struct list_elem *e = list_begin(frames); e != list_end(frames); e = list_next(e))
+	{
+		struct frame *frame = list_entry(e, struct frame, frame_elem);
+		if (!frame_evictable(frame))
+			continue;
+
+		twoq_remove(frame);
+		return frame;
+	}
+	return NULL;
+}
+
+/* Am은 앞쪽이 가장 오래 안 쓰인 쪽입니다. accessed 비트가 켜져 있으면 지우고 뒤로 돌려보냅니다. */
+static struct frame *
+twoq_victim_am(void)
+{
+	for (size_t i = 0; i < 2 * am_cnt && !list_empty(&am_list); i++)
+	{
+		struct frame *frame = list_entry(list_front(&am_list), struct frame, frame_elem);
+		list_remove(&frame->frame_elem);
+		list_push_back(&am_list, &frame->frame_elem);
+		if (!frame_evictable(frame))
+			continue;
+
+		if (frame_is_accessed(frame))
+		{
+			frame_clear_accessed(frame);
+			continue;
+		}
+		twoq_remove(frame);
+		return frame;
+	}
+	return NULL;
+}
+
+/* A1in에서 내보낸 페이지만 유령으로 남깁니다. 내보내기에 실패해 다시 insert되는 프레임이
+ * 제 유령을 만나 Am으로 올라가지 않도록, 고를 때가 아니라 실제로 내보낸 뒤에 기록합니다. */
+static void
+twoq_evicted(struct frame *frame)
+{
+	if (frame->queue != TWOQ_A1IN)
+		return;
+	twoq_ghosts[twoq_ghost_next] = twoq_ghost_key(frame);
+	twoq_ghost_next = (twoq_ghost_next + 1) % TWOQ_GHOST_CNT;
+}
+
+/* A1in이 전체의 1/4보다 크면 A1in에서, 아니면 Am에서 내보냅니다. */
+static struct frame *
+twoq_victim(void)
+{
+	struct frame *victim = NULL;
+	size_t kin = (a1in_cnt + am_cnt) / 4;
+
+	if (a1in_cnt > (kin > 0 ? kin : 1))
+		victim = twoq_victim_a1in();
+	if (victim == NULL)
+		victim = twoq_victim_am();
+	if (victim == NULL)
+		victim = twoq_victim_a1in();
+	return victim;
+}
+
+static const struct evict_policy twoq_policy = {
+	.name = "2q",
+	.init = twoq_init,
+	.insert = twoq_insert,
+	.touch = twoq_touch,
+	.victim = twoq_victim,
+	.remove = twoq_remove,
+	.evicted = twoq_evicted,
+};
+
+/* Helpers */
+static struct page *vm_region_materialize(struct supplemental_page_table *spt, struct vm_region *region, void *va);
+static struct frame *vm_get_victim(void);
+static bool vm_do_claim_page(struct page *page);
+static struct frame *vm_evict_frame(void);
+static bool page_set_readonly(uint64_t *pml4, void *va, void *kva);
+
+/* 초기화 함수와 함께 대기 중인 페이지 객체를 생성합니다. 페이지를 직접 생성하지 말고,
+ * 반드시 이 함수나 `vm_alloc_page`를 통해 생성하세요. */
+bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
+									vm_initializer *init, void *aux)
+{
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	ASSERT(spt!=NULL);
+
+	/* 이미 해당 page가 SPT에 존재하는지 확인합니다 */
+	if (spt_peek_page(spt, upage) == NULL)
+	{
+		/* TODO: VM 타입에 따라 페이지를 생성하고, 초기화 함수를 가져온 뒤,
+		 * TODO: uninit_new를 호출하여 "uninit" 페이지 구조체를 생성하세요.
+		 * TODO: uninit_new 호출 후에는 필요한 필드를 수정해야 합니다. */
+		bool (*page_initializer)(struct page *, enum vm_type, void *kva);
+		struct page *page = malloc(sizeof(struct page));
+		ASSERT(page!=NULL);
+
+		switch (VM_TYPE(type))
+		{
+		case VM_ANON:
+			page_initializer = anon_initializer;
+			break;
+		case VM_FILE:
+			page_initializer = file_backed_initializer;
+			break;
+		default:
+			free(page);
+			goto err;
+			break;
+		}
+
+		uninit_new(page, upage, init, type, aux, page_initializer);
+		page->writable=writable;
+		/* TODO: 생성한 페이지를 spt에 삽입하세요. */
+		if (!spt_insert_page(spt, page))
+		{
+		   // 실패 시 메모리 누수 방지 위해 free
+		   free(page);
+		   // 실패 했으니까 에러로 가야겠지?
+		   goto err;
+		}
+  
+		return true;
+		
+	}
+err:
+	return false;
+}
+
+/* Find VA from spt and return page. On error, return NULL. */
+/* 가상 주소를 통해 SPT에서 페이지를 찾아 리턴합니다.
+ * 에러가 발생하면 NULL을 리턴하세요
+ * 현재 프로세스의 영역(vm_region) 안인데 아직 struct page가 없으면 이때 만듭니다. */
+struct page *
+spt_find_page(struct supplemental_page_table *spt, void *va)
+{
+	struct page *page = spt_peek_page(spt, va);
+	if (page != NULL || va == NULL || spt != &thread_current()->spt)
+		return page;
+
+	struct vm_region *region = vm_region_find(spt, va);
+	return region != NULL ? vm_region_materialize(spt, region, va) : NULL;
+}
+
+/* SPT 인덱스. x86-64 페이지 테이블과 같은 모양의 4단계 기수 트리로, 가상 주소의 비트 47..12를
+ * 단계마다 9비트씩 잘라 씁니다. 마지막 단계(잎)는 struct page * SPT_FANOUT개짜리 배열입니다.
+ * 조회는 항상 4번 따라가면 끝나고, 주소 순서가 그대로 남아 있어 범위를 순서대로 훑을 수 있습니다.
+ * 노드마다 채워진 칸 수를 세어 두었다가 비면 바로 풀어 줍니다. */
+#define SPT_LEVELS 4
+#define SPT_BITS 9
+#define SPT_FANOUT (1 << SPT_BITS)
+
+struct spt_node {
+	void **slots;		/* 자식 노드(잎이면 struct page) 포인터 SPT_FANOUT개. 커널 풀 한 페이지 */
+	size_t cnt;			/* NULL이 아닌 칸 수 */
+};
+
+static inline size_t
+spt_index(uintptr_t va, int level)
+{
+	return (va >> (PGBITS + SPT_BITS * level)) & (SPT_FANOUT - 1);
+}
+
+static struct spt_node *
+spt_node_create(void)
+{
+	struct spt_node *node = malloc(sizeof *node);
+	if (node == NULL)
+		return NULL;
+	node->slots = palloc_get_page(PAL_ZERO);
+	if (node->slots == NULL)
+	{
+		free(node);
+		return NULL;
+	}
+	node->cnt = 0;
+	return node;
+}
+
+static void
+spt_node_free(struct spt_node *node)
+{
+	palloc_free_page(node->slots);
+	free(node);
+}
+
+/* NODE 아래 트리를 통째로 풉니다. 잎에 달린 페이지는 건드리지 않습니다. */
+static void
+spt_node_destroy(struct spt_node *node, int level)
+{
+	if (level > 0)
+		for (size_t i = 0; i < SPT_FANOUT; i++)
+			if (node->slots[i] != NULL)
+				spt_node_destroy(node->slots[i], level - 1);
+	spt_node_free(node);
+}
+
+/* 이미 만들어진 struct page만 찾습니다. 영역 안의 빈 자리를 채우지 않아야 하는 곳
+ * (교체, fork 복사, 해제처럼 페이지를 훑기만 하는 경로)에서 씁니다. */
+struct page *
+spt_peek_page(struct supplemental_page_table *spt, void *va)
+{
+    ASSERT(spt != NULL);
+    // ASSERT(va != NULL);
+	if(va==NULL) return NULL;
+
+	uintptr_t key = (uintptr_t)pg_round_down(va);
+	struct spt_node *node = spt->root;
+	for (int level = SPT_LEVELS - 1; node != NULL && level > 0; level--)
+		node = node->slots[spt_index(key, level)];
+	return node != NULL ? node->slots[spt_index(key, 0)] : NULL;
+}
+
+
+/* Insert PAGE into spt with validation. */
+/* 같은 주소에 이미 페이지가 있거나 노드를 만들 메모리가 없으면 false. */
+bool spt_insert_page(struct supplemental_page_table *spt,
+					 struct page *page)
+{
+	ASSERT(page!=NULL);
+	uintptr_t key = (uintptr_t)page->va;
+
+	if (spt->root == NULL && (spt->root = spt_node_create()) == NULL)
+		return false;
+
+	struct spt_node *node = spt->root;
+	for (int level = SPT_LEVELS - 1; level > 0; level--)
+	{
+		void **slot = &node->slots[spt_index(key, level)];
+		if (*slot == NULL)
+		{
+			if ((*slot = spt_node_create()) == NULL)
+				return false;
+			node->cnt++;
+		}
+		node = *slot;
+	}
+
+	void **slot = &node->slots[spt_index(key, 0)];
+	if (*slot != NULL) return false; //실패했음
+	*slot = page;
+	node->cnt++;
+	spt->page_cnt++;
+	return true;
+}
+
+/* PAGE를 인덱스에서 뺍니다. 그 때문에 빈 노드가 생기면 아래에서부터 위로 풀어 줍니다. */
+void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+{
+	uintptr_t key = (uintptr_t)page->va;
+	struct spt_node *path[SPT_LEVELS];
+	struct spt_node *node = spt->root;
+
+	for (int level = SPT_LEVELS - 1; level >= 0; level--)
+	{
+		if (node == NULL)
+			return;
+		path[level] = node;
+		if (level > 0)
+			node = node->slots[spt_index(key, level)];
+	}
+	if (path[0]->slots[spt_index(key, 0)] != page)
+		return;
+	path[0]->slots[spt_index(key, 0)] = NULL;
+	path[0]->cnt--;
+	spt->page_cnt--;
+
+	for (int level = 0; level < SPT_LEVELS && path[level]->cnt == 0; level++)
+	{
+		spt_node_free(path[level]);
+		if (level + 1 < SPT_LEVELS)
+		{
+			path[level + 1]->slots[spt_index(key, level + 1)] = NULL;
+			path[level + 1]->cnt--;
+		}
+		else
+			spt->root = NULL;
+	}
+	// vm_dealloc_page(page); //<< 이거 쓰면 swap out~->swap in이 안될 것 같은데? 
+
+}
+
+/* BASE에서 시작하는 LEVEL 단계 노드 아래에서 *VA 이상인 첫 페이지를 찾습니다. */
+static struct page *
+spt_node_next(struct spt_node *node, int level, uintptr_t base, uintptr_t *va)
+{
+	int shift = PGBITS + SPT_BITS * level;
+	size_t idx = *va > base ? (*va - base) >> shift : 0;
+
+	for (; idx < SPT_FANOUT; idx++)
+	{
+		void *slot = node->slots[idx];
+		if (slot == NULL)
+			continue;
+
+		uintptr_t child_base = base + ((uintptr_t)idx << shift);
+		if (level == 0)
+		{
+			*va = child_base + PGSIZE;
+			return slot;
+		}
+		struct page *page = spt_node_next(slot, level - 1, child_base, va);
+		if (page != NULL)
+			return page;
+	}
+	return NULL;
+}
+
+/* *VA 이상인 첫 페이지를 주소 순으로 돌려주고 *VA를 그 다음 페이지 주소로 옮깁니다. 없으면 NULL.
+ * 매번 뿌리부터 내려가므로 훑는 도중에 페이지를 지워도 안전하고, 빈 하위 트리는 통째로 건너뜁니다.
+ *     void *va = start;
+ *     while ((page = spt_next_page(spt, &va)) != NULL && page->va < end) ... */
+struct page *
+spt_next_page(struct supplemental_page_table *spt, void **va)
+{
+	uintptr_t cursor = (uintptr_t)*va;
+	struct page *page = spt->root != NULL ? spt_node_next(spt->root, SPT_LEVELS - 1, 0, &cursor) : NULL;
+
+	*va = (void *)cursor;
+	return page;
+}
+
+/* VM이 슬랩에서 만든 file_info의 표시. 로더(load_segment)는 예전처럼 malloc으로 만들고 mapping도 채우지 않으므로
+ * 돌려줄 때 이 표시로 출처를 가립니다 */
+#define FILE_INFO_MAGIC 0x46494e46u
+
+/* file_info를 슬랩에서 만듭니다. 영역과 fork가 만드는 file_info는 모두 여기서 만듭니다.
+ * 어느 쪽에서 만들었든 file_info_free로 돌려주면 됩니다. */
+struct file_info *
+file_info_alloc(void)
+{
+	struct file_info *info = slab_alloc(&file_info_slab);
+	if (info != NULL)
+	{
+		info->magic = FILE_INFO_MAGIC;
+		info->mapping = NULL;
+	}
+	return info;
+}
+
+/* INFO가 file_info_alloc으로 만든 것이면 true. 아니면 로더가 malloc으로 만든 것이고 mapping은 쓰레기입니다. */
+static bool
+file_info_from_slab(const struct file_info *info)
+{
+	return info->magic == FILE_INFO_MAGIC;
+}
+
+/* 매핑 서술자. mmap 하나나 실행 파일 세그먼트 하나마다 하나씩 두고, 파일과 시작 오프셋 같은
+ * 매핑 전체의 정보를 담습니다. 영역, 그 영역에서 만든 페이지의 file_info, fork한 자식의 영역이
+ * 모두 같은 서술자를 참조 카운트로 공유하므로 파일은 매핑마다 한 번만 엽니다.
+ * 파일은 file_read_at/file_write_at으로만 쓰므로 여러 프로세스가 같은 핸들을 써도 됩니다. */
+struct vm_mapping {
+	struct file *file;		/* 매핑이 소유하는 (file_reopen한) 파일 */
+	off_t ofs;				/* 매핑 첫 페이지에 대응하는 파일 오프셋 */
+	size_t file_bytes;		/* 매핑 시작부터 파일에서 읽을 바이트 수. 나머지는 0으로 채웁니다 */
+	bool writable;
+	enum vm_type type;		/* VM_FILE(공유 mmap) 또는 VM_ANON(실행 파일 세그먼트, 사적 mmap) */
+	size_t mmap_length;		/* 만든 페이지의 file_info에 그대로 옮겨 적습니다 */
+	int ref_cnt;
+};
+
+/* 가상 메모리 영역(VMA). 한 프로세스에서 매핑 서술자가 놓인 주소 범위입니다.
+ * 영역을 만들 때는 페이지를 하나도 만들지 않고, 영역 안의 주소가 처음 spt_find_page에 걸릴 때
+ * (대개 폴트 때) 그 페이지 하나의 struct page와 file_info를 만듭니다.
+ * 그래서 mmap은 크기와 상관없이 O(1)이고 한 번도 건드리지 않은 페이지는 메타데이터를 쓰지 않습니다. */
+struct vm_region {
+	uint8_t *start;
+	size_t length;			/* 바이트, PGSIZE의 배수 */
+	struct vm_mapping *map;
+	struct list_elem elem;
+};
+
+/* 참조 카운트는 fork(자식 스레드), 종료, 회수 스레드의 destroy가 함께 건드리므로 인터럽트를 끄고 셉니다. */
+static struct vm_mapping *
+vm_mapping_get(struct vm_mapping *map)
+{
+	enum intr_level old_level = intr_disable();
+	map->ref_cnt++;
+	intr_set_level(old_level);
+	return map;
+}
+
+static void
+vm_mapping_put(struct vm_mapping *map)
+{
+	enum intr_level old_level = intr_disable();
+	bool last = --map->ref_cnt == 0;
+	intr_set_level(old_level);
+
+	if (last)
+	{
+		/* munmap이나 종료 경로의 호출자가 이미 filesys_lock을 잡고 있을 수 있습니다 */
+		bool held = lock_held_by_current_thread(&filesys_lock);
+		if (!held)
+			lock_acquire(&filesys_lock);
+		file_close(map->file);
+		if (!held)
+			lock_release(&filesys_lock);
+		free(map);
+	}
+}
+
+/* 페이지의 file_info를 돌려줍니다. 매핑 서술자에서 나온 것이면 서술자 참조만 놓고,
+ * 예전처럼 페이지마다 file_reopen한 것이면 그 파일을 닫습니다.
+ * 로더가 malloc으로 만든 것은 원래대로 file_close와 free로 돌려줍니다. */
+void file_info_free(struct file_info *info)
+{
+	if (info == NULL)
+		return;
+	if (!file_info_from_slab(info))
+	{
+		file_close(info->file);
+		free(info);
+		return;
+	}
+	if (info->mapping != NULL)
+		vm_mapping_put(info->mapping);
+	else
+		file_close(info->file);
+	info->magic = 0;
+	slab_free(&file_info_slab, info);
+}
+
+/* VA를 덮는 영역을 찾습니다. 없으면 NULL. */
+struct vm_region *
+vm_region_find(struct supplemental_page_table *spt, void *va)
+{
+	for (struct list_elem *e = list_begin(&spt->regions); e != list_end(&spt->regions); e = list_next(e))
+	{
+		struct vm_region *region = list_entry(e, struct vm_region, elem);
+		if ((uint8_t *)va >= region->start && (uint8_t *)va < region->start + region->length)
+			return region;
+	}
+	return NULL;
+}
+
+/* 현재 프로세스의 [START, START + LENGTH)에 매핑 MAP을 놓습니다. MAP의 참조는 영역이 하나 가져갑니다. */
+static bool
+vm_region_attach(void *start, size_t length, struct vm_mapping *map)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+
+	ASSERT(pg_ofs(start) == 0 && length % PGSIZE == 0);
+	if (length == 0)
+		return false;
+	for (struct list_elem *e = list_begin(&spt->regions); e != list_end(&spt->regions); e = list_next(e))
+	{
+		struct vm_region *r = list_entry(e, struct vm_region, elem);
+		if ((uint8_t *)start < r->start + r->length && r->start < (uint8_t *)start + length)
+			return false;
+	}
+
+	struct vm_region *region = malloc(sizeof *region);
+	if (region == NULL)
+		return false;
+	region->start = start;
+	region->length = length;
+	region->map = vm_mapping_get(map);
+	list_push_back(&spt->regions, &region->elem);
+	return true;
+}
+
+/* 현재 프로세스에 [START, START + LENGTH) 영역을 새 매핑 서술자로 만듭니다. START와 LENGTH는 페이지 정렬되어야 합니다.
+ * 페이지 하나하나는 만들지 않으므로 영역 크기와 상관없이 O(1)입니다(겹침 검사는 영역 수에 비례).
+ * FILE은 서술자가 따로 열어 두므로 호출자는 자기 핸들을 닫아도 됩니다. */
+bool vm_region_add(void *start, size_t length, struct file *file, off_t ofs,
+				   size_t file_bytes, bool writable, enum vm_type type, size_t mmap_length)
+{
+	/* 이미 페이지가 있는 자리(코드, 데이터, 스택 등)에는 매핑하지 않습니다. 그 페이지가 매핑을 가리게 됩니다 */
+	void *cursor = start;
+	struct page *page = spt_next_page(&thread_current()->spt, &cursor);
+	if (page != NULL && (uint8_t *)page->va < (uint8_t *)start + length)
+		return false;
+
+	struct vm_mapping *map = malloc(sizeof *map);
+	if (map == NULL)
+		return false;
+	map->file = file_reopen(file);
+	if (map->file == NULL)
+	{
+		free(map);
+		return false;
+	}
+	map->ofs = ofs;
+	map->file_bytes = file_bytes < length ? file_bytes : length;
+	map->writable = writable;
+	map->type = type;
+	map->mmap_length = mmap_length;
+	map->ref_cnt = 1;
+
+	bool success = vm_region_attach(start, length, map);
+	vm_mapping_put(map);
+	return success;
+}
+
+/* REGION이 VA에서 FILE의 OFS 위치를 매핑하고 있는지 봅니다(같은 파일의 같은 자리를 다시 mmap한 경우). */
+bool vm_region_maps(struct vm_region *region, void *va, struct file *file, off_t ofs)
+{
+	struct vm_mapping *map = region->map;
+
+	return file_get_inode(map->file) == file_get_inode(file)
+		&& map->ofs + ((uint8_t *)va - region->start) == (size_t)ofs;
+}
+
+static void
+vm_region_free(struct vm_region *region)
+{
+	list_remove(&region->elem);
+	vm_mapping_put(region->map);
+	free(region);
+}
+
+/* ADDR에서 시작하는 영역을 없애고 그 길이(바이트)를 돌려줍니다. 그런 영역이 없으면 0.
+ * 이미 만들어진 페이지는 호출자가 따로 정리합니다(페이지가 서술자 참조를 따로 들고 있습니다). */
+size_t vm_region_remove(struct supplemental_page_table *spt, void *addr)
+{
+	struct vm_region *region = vm_region_find(spt, addr);
+	if (region == NULL || region->start != addr)
+		return 0;
+
+	size_t length = region->length;
+	vm_region_free(region);
+	return length;
+}
+
+/* 영역 REGION 안의 VA에 해당하는 페이지를 처음으로 만듭니다.
+ * 예전에 do_mmap과 로더가 페이지마다 미리 하던 일(file_info를 채워 lazy_load_segment로 예약)을 지금 하되,
+ * 파일은 다시 열지 않고 매핑 서술자의 것을 참조로 빌려 씁니다. */
+static struct page *
+vm_region_materialize(struct supplemental_page_table *spt, struct vm_region *region, void *va)
+{
+	struct vm_mapping *map = region->map;
+	uint8_t *upage = pg_round_down(va);
+	size_t off = upage - region->start;
+	struct file_info *aux = file_info_alloc();
+	if (aux == NULL)
+		return NULL;
+
+	aux->file = map->file;
+	aux->mapping = vm_mapping_get(map);
+	aux->ofs = map->ofs + off;
+	aux->upage = upage;
+	aux->read_bytes = off < map->file_bytes
+						  ? (map->file_bytes - off < PGSIZE ? map->file_bytes - off : PGSIZE)
+						  : 0;
+	aux->zero_bytes = PGSIZE - aux->read_bytes;
+	aux->writable = map->writable;
+	aux->mmap_length = map->mmap_length;
+
+	if (!vm_alloc_page_with_initializer(map->type, upage, map->writable, lazy_load_segment, aux))
+	{
+		file_info_free(aux);
+		return NULL;
+	}
+	return spt_peek_page(spt, upage);
+}
+
+/* Get the struct frame, that will be evicted. */
+/* 선택된 교체 정책에게 희생 프레임을 받아옵니다. */
+static struct frame *
+vm_get_victim(void)
+{
+	/* 모든 프레임이 고정돼 있으면 NULL. 직접 교체하는 vm_get_frame은 이를 허용하지 않습니다 */
+	return evict_policy->victim();
+}
+
+/* 스왑 클러스터 하나에 담는 최대 페이지 수 */
+#define SWAP_CLUSTER 8
+
+/* FRAME을 매핑한 모든 주소 공간에서 PTE를 내립니다.
+ * pml4_clear_page는 present 비트만 지우므로 dirty 비트는 swap_out에서 그대로 보입니다. */
+static void
+frame_unmap_all(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		pml4_clear_page(map->pml4, map->va);
+	}
+}
+
+/* frame_unmap_all로 끊었던 FRAME의 매핑을 되살립니다. 내보내기에 실패했을 때 씁니다.
+ * pml4_clear_page는 present 비트만 지우므로 그 비트만 다시 세우면 쓰기 권한과 accessed/dirty 비트가 그대로 돌아오고,
+ * 페이지 테이블을 새로 만들지 않으니 실패하지 않습니다. */
+static void
+frame_remap_all(struct frame *frame)
+{
+	for (struct list_elem *e = list_begin(&frame->maps); e != list_end(&frame->maps); e = list_next(e))
+	{
+		struct frame_map *map = list_entry(e, struct frame_map, map_elem);
+		uint64_t *pte = pml4e_walk(map->pml4, (uint64_t)map->va, 0);
+		if (pte != NULL)
+			*pte |= PTE_P;
+	}
+}
+
+/* 내보낸 FRAME의 역매핑을 모두 정리합니다.
+ * PAGE 말고 다른 익명 공유자는 PAGE가 쓴 스왑 슬롯을 함께 가리키고, 파일 공유자는 파일에서 다시 읽습니다. */
+static void
+frame_detach_all(struct frame *frame, struct page *page)
+{
+	while (!list_empty(&frame->maps))
+	{
+		struct frame_map *map = list_entry(list_pop_front(&frame->maps), struct frame_map, map_elem);
+		if (map->page != page && page_get_type(map->page) == VM_ANON)
+			anon_swap_share(map->page, page);
+		map->page->frame = NULL; // 연결 해제
+		slab_free(&frame_map_slab, map);
+	}
+	/* 프레임은 곧 다른 내용으로 다시 쓰이므로 페이지 캐시에서도 뺍니다. 깨끗한 파일 페이지는 이렇게 버려지기만 합니다 */
+	vm_pagecache_forget(frame);
+	frame->page = NULL;
+	frame->r_cnt = 0;
+}
+
+/* 희생 페이지와 함께 스왑 아웃해도 될 이웃 익명 페이지인지 봅니다.
+ * 혼자 쓰는(공유되지 않은) 상주 페이지이고 최근에 참조되지 않았어야 합니다.
+ * 스왑 캐시 슬롯을 가진 페이지는 제 슬롯으로 돌아가야 하므로 새 연속 구간에 넣지 않습니다. */
+static struct page *
+swap_cluster_candidate(struct supplemental_page_table *spt, void *va)
+{
+	struct page *page = spt_peek_page(spt, va);
+
+	if (page == NULL || VM_TYPE(page->operations->type) != VM_ANON || page->anon.swap_idx != -1)
+		return NULL;
+	struct frame *frame = page->frame;
+	if (frame == NULL || frame == &zero_frame || frame->pinned || frame->r_cnt != 1
+		|| frame_is_accessed(frame))
+		return NULL;
+	return page;
+}
+
+/* VICTIM(공유되지 않은 익명 프레임)의 페이지를 가운데 두고, 같은 주소 공간에서 주소가 이어진
+ * 이웃 페이지를 아래/위로 번갈아 넓혀 가며 최대 SWAP_CLUSTER개까지 주소 순서로 CLUSTER에 모읍니다.
+ * 이웃 페이지의 프레임은 고정해 둡니다. 모은 페이지 수를 돌려줍니다.
+ * SPT는 주인이 락 없이 고치고 없애므로, 교체하는 스레드 자신의 주소 공간일 때만 이웃을 찾습니다.
+ * 회수 스레드나 다른 프로세스의 페이지를 내보낼 때는 희생 페이지 하나만 돌려줍니다. */
+static size_t
+swap_cluster_collect(struct frame *victim, struct page **cluster)
+{
+	struct frame_map *map = list_entry(list_front(&victim->maps), struct frame_map, map_elem);
+	uint8_t *va = map->va;
+	size_t below = 0, above = 0;
+	bool grow_down = true, grow_up = true;
+
+	if (map->spt != &thread_current()->spt)
+	{
+		cluster[0] = victim->page;
+		return 1;
+	}
+
+	while (below + above + 1 < SWAP_CLUSTER && (grow_down || grow_up))
+	{
+		if (grow_down)
+		{
+			if (swap_cluster_candidate(map->spt, va - (below + 1) * PGSIZE) != NULL)
+				below++;
+			else
+				grow_down = false;
+		}
+		if (grow_up && below + above + 1 < SWAP_CLUSTER)
+		{
+			if (swap_cluster_candidate(map->spt, va + (above + 1) * PGSIZE) != NULL)
+				above++;
+			else
+				grow_up = false;
+		}
+	}
+
+	size_t cnt = 0;
+	for (size_t i = below; i > 0; i--)
+		cluster[cnt++] = spt_peek_page(map->spt, va - i * PGSIZE);
+	cluster[cnt++] = victim->page;
+	for (size_t i = 1; i <= above; i++)
+		cluster[cnt++] = spt_peek_page(map->spt, va + i * PGSIZE);
+
+	for (size_t i = 0; i < cnt; i++)
+		cluster[i]->frame->pinned = true;
+	return cnt;
+}
+
+/* 한 페이지를 교체(evict)하고 해당 프레임을 반환합니다.
+ * 에러가 발생하면 NULL을 반환합니다.
+ * 희생 페이지가 혼자 쓰는 익명 페이지면, 같은 주소 공간에서 주소가 이어진 차가운 이웃 페이지들을
+ * 모아 이어진 스왑 슬롯에 한꺼번에 내보내고(클러스터), 이웃들의 프레임은 풀에 돌려줍니다. */
+static struct frame *
+vm_evict_frame(void)
+{
+	struct frame *victim  = vm_get_victim();
+	if(victim==NULL) return NULL;	
+
+	struct page *page =victim->page;
+	if (page) {
+		vm_trace(VM_TRACE_EVICT, page->va, 0, victim->r_cnt);
+		struct page *cluster[SWAP_CLUSTER];
+		size_t cnt = 0;
+		int first_slot = -1;
+
+		/* 내보내는 동안(디스크 I/O 중) 다른 교체가 같은 프레임을 다시 고르지 않도록 고정합니다 */
+		victim->pinned = true;
+
+		if (page_get_type(page) == VM_ANON && victim->r_cnt == 1 && page->anon.swap_idx == -1)
+		{
+			cnt = swap_cluster_collect(victim, cluster);
+			if (cnt > 1 && (first_slot = anon_swap_alloc_run(cnt)) == -1)
+			{
+				for (size_t i = 0; i < cnt; i++)
+					cluster[i]->frame->pinned = false;
+				cnt = 0;
+			}
+		}
+
+		if (cnt > 1)
+		{
+			for (size_t i = 0; i < cnt; i++)
+				frame_unmap_all(cluster[i]->frame);
+			anon_swap_out_cluster(cluster, cnt, first_slot);
+			for (size_t i = 0; i < cnt; i++)
+			{
+				struct frame *frame = cluster[i]->frame;
+				if (frame == victim)
+					continue;
+				frame_detach_all(frame, cluster[i]);
+				frame_table_free(frame);
+			}
+		}
+		else
+		{
+			/* 공유 중인 모든 주소 공간에서 먼저 매핑을 끊어, 내보내는 동안 내용이 바뀌지 않게 합니다 */
+			frame_unmap_all(victim);
+			if (!swap_out(page))
+			{
+				/* 스왑이 가득 찼습니다. 매핑을 되살리고 다시 교체 후보로 돌려놓습니다 */
+				frame_remap_all(victim);
+				evict_policy->insert(victim);
+				victim->pinned = false;
+				return NULL;
+			}
+		}
+
+		/* 역매핑이 남아 있을 때 알려야 정책이 (주소 공간, 주소)를 기억할 수 있습니다 */
+		if (evict_policy->evicted != NULL)
+			evict_policy->evicted(victim);
+
+		/* 나머지 공유자들의 페이지도 같은 스왑 슬롯(또는 파일)을 가리키게 하고 연결을 끊습니다 */
+		frame_detach_all(victim, page);
+		victim->pinned = false;
+
+		return victim;
+	}
+	return NULL;
+
+}
+
+/* 프레임 풀(회수해 둔 ready_frames 또는 0으로 채운 zero_frames) POOL에서 프레임을 하나 꺼냅니다. 없으면 NULL.
+ * 폴트 경로와 백그라운드 스레드가 함께 건드리므로 짧게 인터럽트를 끄고 다룹니다. */
+static struct frame *
+frame_pool_pop(struct list *pool, size_t *cnt)
+{
+	struct frame *frame = NULL;
+	enum intr_level old_level = intr_disable();
+
+	if (!list_empty(pool))
+	{
+		frame = list_entry(list_pop_front(pool), struct frame, frame_elem);
+		(*cnt)--;
+	}
+	intr_set_level(old_level);
+	return frame;
+}
+
+static void
+frame_pool_push(struct list *pool, size_t *cnt, struct frame *frame)
+{
+	enum intr_level old_level = intr_disable();
+
+	list_push_back(pool, &frame->frame_elem);
+	(*cnt)++;
+	intr_set_level(old_level);
+}
+
+/* 바로 쓸 수 있는 사용자 프레임 수: palloc에 남은 프레임과 두 풀에 쌓아 둔 프레임의 합 */
+static size_t
+vm_free_frames(void)
+{
+	return frame_table->frame_cnt - frame_alloc_cnt + ready_cnt + zero_cnt;
+}
+
+/* 남은 프레임이 낮은 워터마크 아래면 회수 스레드를 깨웁니다. */
+static void
+reclaim_check(void)
+{
+	if (reclaim_running && vm_free_frames() < reclaim_low)
+		sema_up(&reclaim_sema);
+}
+
+/* 회수 스레드. 깨어날 때마다 높은 워터마크까지 페이지를 내보내 프레임을 ready_frames에 채웁니다.
+ * 스왑 쓰기와 파일 write-back을 여기서 하므로 폴트를 낸 스레드는 대부분 기다리지 않습니다. */
+static void
+reclaim_thread(void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down(&reclaim_sema);
+		while (vm_free_frames() < reclaim_high)
+		{
+			lock_acquire(&evict_lock);
+			struct frame *frame = vm_evict_frame();
+			lock_release(&evict_lock);
+			if (frame == NULL)
+				break;
+			frame_pool_push(&ready_frames, &ready_cnt, frame);
+		}
+	}
+}
+
+/* 워터마크를 정하고 회수 스레드를 띄웁니다. frame_table_init() 다음에 불러야 합니다. */
+static void
+reclaim_start(void)
+{
+	size_t frame_cnt = frame_table->frame_cnt;
+
+	lock_init(&evict_lock);
+	cond_init(&flush_cond);
+	sema_init(&reclaim_sema, 0);
+	list_init(&ready_frames);
+
+	if (!reclaim_low_set)
+		reclaim_low = RECLAIM_LOW_DEFAULT(frame_cnt);
+	if (!reclaim_high_set || reclaim_high < reclaim_low)
+		reclaim_high = reclaim_low * 2;
+	if (reclaim_high > frame_cnt / 2)
+		reclaim_high = frame_cnt / 2;
+	if (reclaim_low == 0 || reclaim_low > reclaim_high)
+		return;
+
+	reclaim_running = thread_create("reclaim", PRI_DEFAULT, reclaim_thread, NULL) != TID_ERROR;
+}
+
+/* 교체와 플러셔를 멈추고 프레임 테이블을 다룰 수 있게 합니다. 플러셔가 쓰는 중이면 끝날 때까지 기다립니다.
+ * 주인 프로세스가 페이지를 없애거나 직접 쓸 프레임을 고정할 때 씁니다. */
+void frame_table_lock(void)
+{
+	lock_acquire(&evict_lock);
+	while (flushing != NULL)
+		cond_wait(&flush_cond, &evict_lock);
+}
+
+void frame_table_unlock(void)
+{
+	lock_release(&evict_lock);
+}
+
+/* 플러셔 스레드. 프레임 배열을 한 바퀴 돌며 더럽혀진 파일 기반 프레임을 써 둡니다.
+ * 프레임을 고르고 고정하는 동안만 evict_lock을 잡고 쓰기는 락 없이 합니다. 고정한 프레임은 교체되지 않고,
+ * 주인은 frame_table_lock에서 쓰기가 끝나길 기다리므로 쓰는 동안 페이지가 사라지지 않습니다. */
+static void
+flusher_thread(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_sleep(flush_interval);
+		for (size_t i = 0; i < frame_table->frame_cnt; i++)
+		{
+			struct frame *frame = &frame_table->frames[i];
+
+			lock_acquire(&evict_lock);
+			struct page *page = frame->page;
+			if (page == NULL || frame->pinned || VM_TYPE(page->operations->type) != VM_FILE
+				|| !frame_is_dirty(frame))
+			{
+				lock_release(&evict_lock);
+				continue;
+			}
+			frame->pinned = true;
+			flushing = frame;
+			lock_release(&evict_lock);
+
+			file_backed_flush(page);
+
+			lock_acquire(&evict_lock);
+			frame->pinned = false;
+			flushing = NULL;
+			cond_broadcast(&flush_cond, &evict_lock);
+			lock_release(&evict_lock);
+		}
+	}
+}
+
+/* 0 풀을 채우는 스레드. 가장 낮은 우선순위로 돌아 다른 스레드가 모두 쉬고 있을 때만 일합니다.
+ * palloc에 남은 프레임이 회수 스레드의 높은 워터마크보다 많을 때만 가져가므로 교체를 부르지 않습니다. */
+static void
+zero_thread(void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down(&zero_sema);
+		while (zero_cnt < zero_target && frame_table->frame_cnt - frame_alloc_cnt > reclaim_high)
+		{
+			void *kva = palloc_get_page(PAL_USER);
+			if (kva == NULL)
+				break;
+			frame_alloc_cnt++;
+
+			struct frame *frame = frame_table_lookup(kva);
+			frame->r_cnt = 0;
+			frame->page = NULL;
+			frame->pinned = false;
+			memset(kva, 0, PGSIZE);
+			frame_pool_push(&zero_frames, &zero_cnt, frame);
+			thread_yield();
+		}
+	}
+}
+
+/* 0 풀이 절반 아래로 줄었으면 채우는 스레드를 깨웁니다. */
+static void
+zero_pool_check(void)
+{
+	if (zero_running && zero_cnt < zero_target / 2)
+		sema_up(&zero_sema);
+}
+
+static void
+zero_pool_start(void)
+{
+	list_init(&zero_frames);
+	sema_init(&zero_sema, 1);
+	if (!zero_target_set)
+		zero_target = ZERO_POOL_DEFAULT(frame_table->frame_cnt);
+	if (zero_target > frame_table->frame_cnt / 4)
+		zero_target = frame_table->frame_cnt / 4;
+	if (zero_target > 0)
+		zero_running = thread_create("zero", PRI_MIN, zero_thread, NULL) != TID_ERROR;
+}
+
+static void
+flusher_start(void)
+{
+	if (flush_interval > 0)
+		thread_create("flusher", PRI_DEFAULT, flusher_thread, NULL);
+}
+
+/* palloc()을 사용하여 프레임을 할당합니다.
+ * 사용 가능한 페이지가 없으면 페이지를 교체(evict)하여 반환합니다.
+ * 이 함수는 항상 유효한 주소를 반환합니다. 즉, 사용자 풀 메모리가 가득 차면,
+ * 이 함수는 프레임을 교체하여 사용 가능한 메모리 공간을 확보합니다.
+ * ZERO가 true면 0으로 채운 프레임을 돌려주고, false면 내용이 무엇이든 상관없는 호출자(스왑 인, 파일 읽기,
+ * 복사)로 보고 채우지 않습니다. */
+static struct frame *
+vm_get_frame(bool zero)
+{
+	struct frame *frame = NULL;
+	bool zeroed = false;
+
+	/* 0으로 채운 프레임이 필요하면 미리 채워 둔 풀에서 먼저 꺼냅니다 */
+	if (zero && (frame = frame_pool_pop(&zero_frames, &zero_cnt)) != NULL)
+		zeroed = true;
+	else
+	{
+		void *kva = palloc_get_page(PAL_USER | (zero ? PAL_ZERO : 0));
+		if (kva != NULL)
+		{
+			frame = frame_table_lookup(kva);
+			frame->r_cnt=0;
+			frame->page=NULL;
+			frame->pinned=false;
+			frame_alloc_cnt++;
+			zeroed = zero;
+		}
+	}
+	if(frame==NULL){
+		/* 회수 스레드가 비워 둔 프레임, 0 풀의 프레임 순으로 쓰고, 없으면 직접 교체합니다.
+		 * 교체된 프레임은 같은 물리 페이지를 담당하는 구조체를 그대로 다시 씁니다 */
+		frame = frame_pool_pop(&ready_frames, &ready_cnt);
+		if (frame == NULL && (frame = frame_pool_pop(&zero_frames, &zero_cnt)) != NULL)
+			zeroed = true;
+		if (frame == NULL)
+		{
+			lock_acquire(&evict_lock);
+			frame = vm_evict_frame(); //이 안에서 swap out
+			lock_release(&evict_lock);
+		}
+		ASSERT(frame!=NULL);
+	}
+	/* 회수하거나 교체한 프레임에는 이전 페이지의 내용이 그대로 남아 있습니다 */
+	if (zero && !zeroed)
+		memset(frame->kva, 0, PGSIZE);
+	reclaim_check();
+	zero_pool_check();
+	
+	ASSERT(frame != NULL);
+	ASSERT(frame->page == NULL);
+	ASSERT(frame->kva!=NULL);
+	return frame;
+}
+
+/* 스택이 자랄 수 있는 가장 낮은 주소(1MB 제한) */
+#define STACK_LIMIT ((uint8_t *)USER_STACK - (1 << 20))
+/* 한 번의 스택 확장에서 폴트 주소 아래로 미리 늘려 두는 최대 페이지 수 */
+#define STACK_PREGROW_MAX 8
+
+/* 스택 확장에 쓸 수 있는 빈 자리인지 봅니다. 아직 만들어지지 않은 mmap 영역도 자리를 차지한 것으로 봅니다. */
+static bool
+stack_slot_free(struct supplemental_page_table *spt, void *va)
+{
+	return spt_peek_page(spt, va) == NULL && vm_region_find(spt, va) == NULL;
+}
+
+/* Growing the stack. */
+/* ADDR에서 난 스택 폴트를 처리합니다. 지금 스택의 가장 낮은 페이지와 폴트 페이지 사이의 빈 구간을 한 번에
+ * 채우고, 폴트 페이지 아래로도 그 구간만큼(최대 STACK_PREGROW_MAX) 미리 늘려 둡니다.
+ * 늘린 페이지는 바로 프레임을 붙여 매핑하므로 같은 주소에서 두 번째 폴트가 나지 않고,
+ * 큰 스택 프레임을 한꺼번에 잡는 함수일수록 미리 늘리는 폭도 커집니다.
+ * 폴트 페이지까지 채웠으면 true. 미리 늘리다가 실패한 것은 무시합니다. */
+static bool
+vm_stack_growth(void *addr)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *fault_page = pg_round_down(addr);
+	uint8_t *top = fault_page + PGSIZE;
+
+	while (top < (uint8_t *)USER_STACK && stack_slot_free(spt, top))
+		top += PGSIZE;
+
+	size_t gap = (top - fault_page) / PGSIZE;
+	size_t extra = gap < STACK_PREGROW_MAX ? gap : STACK_PREGROW_MAX;
+	size_t room = (fault_page - STACK_LIMIT) / PGSIZE;
+	uint8_t *bottom = fault_page - (extra < room ? extra : room) * PGSIZE;
+
+	/* 스택이 자라는 방향대로 위에서부터 채웁니다 */
+	for (uint8_t *va = top - PGSIZE; va >= bottom; va -= PGSIZE)
+	{
+		if (va < fault_page && !stack_slot_free(spt, va))
+			break;
+		if (!vm_alloc_page(VM_ANON, va, true) || !vm_claim_page(va))
+			return va < fault_page;
+	}
+	return true;
+}
+
+/* Handle the fault on write_protected page */
+/* 쓰기 금지된 공유(COW) 프레임에 쓰려고 할 때 불립니다.
+ * 이미 다른 공유자가 모두 떠나 혼자 쓰는 프레임이면 복사 없이 쓰기 권한만 돌려주고,
+ * 아니면 새 프레임에 내용을 복사해 이 페이지만 떼어 냅니다.
+ * page->frame을 확인한 frame_table_lock을 잡은 채 불리며, 프레임을 구하기 전에 놓습니다. */
+static bool
+vm_handle_wp(struct page *page)
+{
+	struct frame *old_frame = page->frame;
+	uint64_t *pml4 = thread_current()->pml4;
+
+	/* 공유 0 페이지에 처음 쓰는 경우: 복사할 필요 없이 0으로 채운 새 프레임을 붙입니다.
+	 * 0 프레임은 교체되지 않으므로 락을 먼저 놓습니다 */
+	if (old_frame == &zero_frame)
+	{
+		frame_table_unlock();
+		struct frame *frame = vm_get_frame(true);
+		page->frame = NULL;
+		frame_table_insert(frame, page);
+		if (!pml4_set_page(pml4, page->va, frame->kva, true))
+			return vm_map_failed(page);
+		frame->pinned = false;
+		return true;
+	}
+
+	/* 혼자 쓰는 프레임에 직접 쓰게 되면 더 이상 파일 내용과 같지 않으므로 페이지 캐시에서 뺍니다 */
+	if (old_frame->r_cnt == 1)
+	{
+		vm_pagecache_forget(old_frame);
+		bool success = pml4_set_page(pml4, page->va, old_frame->kva, true);
+		frame_table_unlock();
+		return success;
+	}
+
+	/* 새 프레임을 구하다가(교체) 원본 프레임이 교체되지 않도록 락을 놓기 전에 고정하고, 복사가 끝날 때까지 둡니다 */
+	old_frame->pinned = true;
+	frame_table_unlock();
+	struct frame * frame=vm_get_frame(false);
+	memcpy(frame->kva, old_frame->kva, PGSIZE);
+
+	frame_table_lock();
+	old_frame->pinned = false;
+	/* 이 페이지는 곧 새 프레임에 쓰므로 스왑 캐시 슬롯은 더 이상 내용과 맞지 않습니다 */
+	if (VM_TYPE(page->operations->type) == VM_ANON)
+		anon_swap_drop(page);
+	frame_table_unlink(page);
+	frame_table_unlock();
+	frame_table_insert(frame, page);
+
+	if (!pml4_set_page(pml4, page->va, frame->kva, true))
+		return vm_map_failed(page);
+	frame->pinned = false;
+
+	return true;
+}
+
+/* 아직 한 번도 쓰지 않은 익명 페이지(스택이나 vm_alloc_page(VM_ANON, ...)로 만든 페이지)인지 확인합니다. */
+static bool
+page_is_untouched_anon(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_UNINIT
+		&& VM_TYPE(page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL
+		&& page->uninit.aux == NULL;
+}
+
+/* 읽기 폴트가 난 미사용 익명 페이지를 공유 0 프레임에 읽기 전용으로 매핑합니다.
+ * 프레임은 첫 쓰기 때 vm_handle_wp에서 할당합니다. */
+static bool
+vm_map_zero_page(struct page *page)
+{
+	if (!page->uninit.page_initializer(page, VM_ANON, NULL))
+		return false;
+	page->frame = &zero_frame;
+	return pml4_set_page(thread_current()->pml4, page->va, zero_frame.kva, false);
+}
+
+/* 파일에서 내용을 읽어 와야 하는(아직 올라오지 않은) 페이지면 그 파일 정보를 돌려줍니다.
+ * mmap 페이지(VM_FILE)와 lazy_load_segment로 예약된 실행 파일 세그먼트가 해당됩니다. */
+static struct file_info *
+page_file_info(struct page *page)
+{
+	if (page->frame != NULL)
+		return NULL;
+
+	switch (VM_TYPE(page->operations->type))
+	{
+	case VM_UNINIT:
+		return page->uninit.init == lazy_load_segment ? page->uninit.aux : NULL;
+	case VM_FILE:
+		return page->file.aux;
+	default:
+		return NULL;
+	}
 }
 
-/* Helpers */
-static struct frame *vm_get_victim(void);
-static bool vm_do_claim_page(struct page *page);
-static struct frame *vm_evict_frame(void);
+/* 파일 정보 INFO로 채워질 PAGE가 올라온 뒤 어떤 타입이 될지 돌려줍니다. */
+static enum vm_type
+page_file_type(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_UNINIT ? VM_TYPE(page->uninit.type) : VM_FILE;
+}
 
-/* 초기화 함수와 함께 대기 중인 페이지 객체를 생성합니다. 페이지를 직접 생성하지 말고,
- * 반드시 이 함수나 `vm_alloc_page`를 통해 생성하세요. */
-bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
-									vm_initializer *init, void *aux)
+/* 읽기 폴트가 난 파일 페이지 PAGE를, 다른 프로세스가 이미 읽어 둔 캐시 프레임에 읽기 전용으로 매핑합니다.
+ * 캐시에 없으면 false를 돌려 평범한 경로(디스크 읽기)로 처리하게 합니다. */
+static bool
+vm_map_cached_page(struct page *page, struct file_info *info)
 {
+	enum vm_type type = page_file_type(page);
 
-	struct supplemental_page_table *spt = &thread_current()->spt;
-	ASSERT(spt!=NULL);
+	/* 타입을 바꾼 뒤에는 되돌릴 수 없으므로 페이지 테이블부터 만들어 둡니다 */
+	if (!vm_reserve_pte(page->va))
+		return false;
 
-	/* 이미 해당 page가 SPT에 존재하는지 확인합니다 */
-	if (spt_find_page(spt, upage) == NULL)
+	/* 교체는 victim()으로 고른 뒤에야 프레임을 고정하므로, 찾고 고정하고 역매핑에 넣는 것까지 evict_lock 안에서 합니다.
+	 * 그러면 교체 중인 프레임은 이미 캐시에서 빠졌거나 아직 고르기 전입니다 */
+	lock_acquire(&evict_lock);
+	struct frame *frame = vm_pagecache_lookup(file_get_inode(info->file), info->ofs, info->read_bytes, type);
+	if (frame == NULL)
 	{
-		/* TODO: VM 타입에 따라 페이지를 생성하고, 초기화 함수를 가져온 뒤,
-		 * TODO: uninit_new를 호출하여 "uninit" 페이지 구조체를 생성하세요.
-		 * TODO: uninit_new 호출 후에는 필요한 필드를 수정해야 합니다. */
-		bool (*page_initializer)(struct page *, enum vm_type, void *kva);
-		struct page *page = malloc(sizeof(struct page));
-		ASSERT(page!=NULL);
-
-		switch (VM_TYPE(type))
-		{
-		case VM_ANON:
-			page_initializer = anon_initializer;
-			break;
-		case VM_FILE:
-			page_initializer = file_backed_initializer;
-			break;
-		default:
-			free(page);
-			goto err;
-			break;
-		}
+		lock_release(&evict_lock);
+		return false;
+	}
 
-		uninit_new(page, upage, init, type, aux, page_initializer);
-		page->writable=writable;
-		/* TODO: 생성한 페이지를 spt에 삽입하세요. */
-		if (!spt_insert_page(spt, page))
+	/* 내용은 이미 프레임에 있으므로 uninit 페이지는 초기화 콜백 없이 타입만 바꿉니다.
+	 * 익명 세그먼트 페이지는 이제 파일 정보를 쓰지 않으므로(lazy_load_segment가 하던 대로) 돌려줍니다 */
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		void *aux = page->uninit.aux;
+		if (!page->uninit.page_initializer(page, type, frame->kva))
 		{
-		   // 실패 시 메모리 누수 방지 위해 free
-		   free(page);
-		   // 실패 했으니까 에러로 가야겠지?
-		   goto err;
+			frame->pinned = false;
+			lock_release(&evict_lock);
+			return false;
 		}
-  
-		return true;
-		
+		if (type == VM_ANON)
+			file_info_free(aux);
 	}
-err:
-	return false;
+
+	frame_map_add(frame, page);
+	lock_release(&evict_lock);
+	if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, false))
+		return vm_map_failed(page);
+	frame->pinned = false;
+	return true;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
-/* 가상 주소를 통해 SPT에서 페이지를 찾아 리턴합니다.
- * 에러가 발생하면 NULL을 리턴하세요 */
-struct page *
-spt_find_page(struct supplemental_page_table *spt, void *va)
+/* 파일에서 방금 읽어 올린 PAGE의 프레임을 페이지 캐시에 넣습니다.
+ * 쓰기 가능한 페이지는 읽기 전용으로 다시 매핑해, 첫 쓰기 때 vm_handle_wp가 캐시에서 떼어 내게 합니다.
+ * 다시 매핑하지 못하면 프레임을 풀고 false를 돌려줍니다. */
+static bool
+vm_cache_page(struct page *page, struct inode *inode, off_t ofs, size_t read_bytes, enum vm_type type)
 {
-    ASSERT(spt != NULL);
-    // ASSERT(va != NULL);
-	if(va==NULL) return NULL;
+	struct frame *frame = page->frame;
 
-	struct page temp;
-	temp.va = pg_round_down(va);
-	
-	struct hash_elem *e = hash_find(&spt->spt_hash, &temp.hash_elem);
-	
-	if (e == NULL)
-		return NULL;
-	else
-		return hash_entry(e, struct page, hash_elem);
-	
+	if (frame == NULL || frame == &zero_frame || frame->r_cnt != 1)
+		return true;
+	if (page->writable && !page_set_readonly(thread_current()->pml4, page->va, frame->kva))
+	{
+		frame_table_lock();
+		frame_table_unlink(page);
+		frame_table_unlock();
+		return false;
+	}
+	vm_pagecache_insert(frame, inode, ofs, read_bytes, type);
+	return true;
 }
 
-
-/* Insert PAGE into spt with validation. */
-bool spt_insert_page(struct supplemental_page_table *spt,
-					 struct page *page)
+/* 미리 읽기(read-ahead) 스트림. 프로세스(spt)와 파일(inode) 쌍마다 최근 폴트 기록을 두고
+ * 순차 접근이면 창을 두 배로 늘리고, 미리 읽었는데 쓰이지 않은 페이지가 있으면 줄입니다. */
+#define RA_STREAM_CNT 8
+#define RA_MAX_PAGES 16
+
+struct ra_stream {
+	struct supplemental_page_table *spt;
+	struct inode *inode;
+	void *next_va;		/* 순차 접근이라면 다음 폴트가 날 주소 */
+	void *ra_start;		/* 직전에 미리 읽은 구간의 시작 */
+	size_t ra_cnt;		/* 직전에 미리 읽은 페이지 수 */
+	size_t window;		/* 다음 폴트에서 함께 읽을 이웃 페이지 수 */
+	unsigned stamp;		/* 가장 오래 안 쓰인 스트림을 재활용하기 위한 순번 */
+};
+
+static struct ra_stream ra_streams[RA_STREAM_CNT];
+static unsigned ra_clock;
+
+static struct ra_stream *
+ra_stream_get(struct supplemental_page_table *spt, struct inode *inode)
 {
-	int succ = false;
-	ASSERT(page!=NULL);
-	struct hash_elem * e=hash_insert(&spt->spt_hash, &page->hash_elem);
-	if(e!=NULL) return succ; //실패했음
+	struct ra_stream *oldest = &ra_streams[0];
+
+	for (size_t i = 0; i < RA_STREAM_CNT; i++)
+	{
+		struct ra_stream *stream = &ra_streams[i];
+		if (stream->spt == spt && stream->inode == inode)
+		{
+			stream->stamp = ++ra_clock;
+			return stream;
+		}
+		if (stream->stamp < oldest->stamp)
+			oldest = stream;
+	}
 
-	succ=true;
-	return succ;
+	*oldest = (struct ra_stream) {
+		.spt = spt,
+		.inode = inode,
+		.stamp = ++ra_clock,
+	};
+	return oldest;
 }
 
-void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+/* 직전에 미리 읽은 페이지 중 아직 한 번도 참조되지 않은 페이지 수를 셉니다. */
+static size_t
+ra_count_unused(struct ra_stream *stream)
 {
-	hash_delete(&spt->spt_hash, &page->hash_elem);	
-	// vm_dealloc_page(page); //<< 이거 쓰면 swap out~->swap in이 안될 것 같은데? 
+	struct thread *cur = thread_current();
+	size_t unused = 0;
 
+	for (size_t i = 0; i < stream->ra_cnt; i++)
+	{
+		void *va = (uint8_t *)stream->ra_start + i * PGSIZE;
+		struct page *page = spt_peek_page(&cur->spt, va);
+		if (page != NULL && page->frame != NULL && !pml4_is_accessed(cur->pml4, va))
+			unused++;
+	}
+	return unused;
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
-vm_get_victim(void)
+/* 주인 없는 프레임(아직 페이지와 연결하지 않은 프레임)을 풀에 돌려줍니다. */
+static void
+frame_release_unlinked(struct frame *frame)
 {
-	struct frame *victim;
-	/* TODO: 교체 정책을 여기서 구현해서 희생자 페이지 찾기 */
-
-	ASSERT(list_empty(&frame_table->frame_list)==false);
-		
-
-	victim = list_entry(list_pop_front(&frame_table->frame_list), struct frame, frame_elem);
-	ASSERT(victim!=NULL);
+	ASSERT(list_empty(&frame->maps));
+	frame->pinned = false;
+	frame->page = NULL;
+	palloc_free_page(frame->kva);
+	frame_alloc_cnt--;
+}
 
-	return victim;
+/* 내용을 채운(고정된) FRAME을 PAGE와 연결하고 현재 주소 공간에 매핑한 뒤 고정을 풉니다.
+ * 매핑하지 못하면 프레임을 풀고 false를 돌려줍니다. */
+static bool
+vm_install_frame(struct page *page, struct frame *frame)
+{
+	frame_table_insert(frame, page);
+	if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable))
+		return vm_map_failed(page);
+	frame->pinned = false;
+	return true;
 }
 
-/* 한 페이지를 교체(evict)하고 해당 프레임을 반환합니다.
- * 에러가 발생하면 NULL을 반환합니다.*/
-static struct frame *
-vm_evict_frame(void)
+/* 파일 기반 페이지 PAGE의 폴트를 처리하면서, 같은 파일의 뒤이은 오프셋을 가진 이웃 페이지를
+ * 최대 WINDOW개까지 함께 읽어 매핑합니다(fault-around).
+ * 프레임을 모두 먼저 확보한 뒤 filesys_lock을 한 번만 잡고 읽습니다.
+ * PAGE 자체를 처리했으면 true, 아무것도 하지 않았으면 false를 돌려주며,
+ * READ_AHEAD에 미리 읽은 이웃 페이지 수를, SUCCESS에 PAGE를 매핑했는지를 기록합니다. */
+static bool
+vm_fault_around(struct page *page, struct file_info *info, size_t window, bool write, size_t *read_ahead,
+				bool *success)
 {
-	struct frame *victim  = vm_get_victim();
-	if(victim==NULL) return NULL;	
+	struct thread *cur = thread_current();
+	struct inode *inode = file_get_inode(info->file);
+	struct page *pages[RA_MAX_PAGES + 1];
+	struct frame *frames[RA_MAX_PAGES + 1];
+	bool loaded[RA_MAX_PAGES + 1];
+	size_t cnt = 1;
+
+	*read_ahead = 0;
+	*success = true;
+	pages[0] = page;
+	for (size_t i = 1; i <= window; i++)
+	{
+		struct page *next = spt_find_page(&cur->spt, (uint8_t *)page->va + i * PGSIZE);
+		struct file_info *next_info = next != NULL ? page_file_info(next) : NULL;
 
-	struct page *page =victim->page;
-	if (page) {
-		if (!swap_out(page))
-			return NULL;
-		pml4_clear_page(thread_current()->pml4, page->va);
-		// list_remove(&page->frame->frame_elem);
+		if (next_info == NULL || file_get_inode(next_info->file) != inode
+			|| next_info->ofs != info->ofs + (off_t)(i * PGSIZE))
+			break;
+		pages[cnt++] = next;
+	}
+	if (cnt == 1)
+		return false;
 
-		page->frame = NULL; // 연결 해제
+	/* 교체가 파일 write-back을 할 수 있으므로 filesys_lock을 잡기 전에 프레임부터 구합니다 */
+	for (size_t i = 0; i < cnt; i++)
+	{
+		frames[i] = vm_get_frame(false);
+		frames[i]->pinned = true;
+	}
 
-		return victim;
+	int64_t start = timer_ticks();
+	lock_acquire(&filesys_lock);
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct file_info *pinfo = page_file_info(pages[i]);
+		loaded[i] = file_read_at(pinfo->file, frames[i]->kva, pinfo->read_bytes, pinfo->ofs)
+					== (int)pinfo->read_bytes;
+		vm_stat_io(false, pinfo->read_bytes);
 	}
-	return NULL;
+	lock_release(&filesys_lock);
+	vm_stat_time(VM_LAT_FILE_READ, timer_elapsed(start));
+
+	for (size_t i = 0; i < cnt; i++)
+	{
+		struct page *p = pages[i];
+		struct file_info *pinfo = page_file_info(p);
+		enum vm_type type = page_file_type(p);
+		off_t ofs = pinfo->ofs;
+		size_t read_bytes = pinfo->read_bytes;
+		/* 타입을 바꾼 뒤에는 파일 정보가 없어 되돌릴 수 없으므로 페이지 테이블부터 만들어 둡니다 */
+		bool ok = loaded[i] && vm_reserve_pte(p->va);
+
+		if (ok)
+		{
+			memset((uint8_t *)frames[i]->kva + pinfo->read_bytes, 0, PGSIZE - pinfo->read_bytes);
+			/* 내용은 이미 읽었으므로 uninit 페이지는 초기화 콜백 없이 타입만 바꿉니다.
+			 * 익명 페이지는 파일 정보를 더 쓰지 않으므로 lazy_load_segment가 하던 대로 여기서 돌려줍니다 */
+			if (VM_TYPE(p->operations->type) == VM_UNINIT)
+			{
+				ok = p->uninit.page_initializer(p, p->uninit.type, frames[i]->kva);
+				if (ok && type == VM_ANON)
+					file_info_free(pinfo);
+			}
+		}
+		if (!ok)
+		{
+			frame_release_unlinked(frames[i]);
+			if (i == 0)
+			{
+				for (size_t j = 1; j < cnt; j++)
+					frame_release_unlinked(frames[j]);
+				return false;
+			}
+			continue;
+		}
 
+		/* 이웃 페이지는 아직 아무도 쓰지 않았지만, 쓰기 가능한 이웃까지 읽기 전용으로 두면 쓸 때마다 폴트가 한 번 더 납니다.
+		 * 매핑에 실패한 이웃은 버리고, PAGE가 실패하면 나머지 프레임을 돌려주고 폴트를 실패시킵니다 */
+		ok = vm_install_frame(p, frames[i]);
+		if (ok && (i == 0 ? !write : !p->writable))
+			ok = vm_cache_page(p, inode, ofs, read_bytes, type);
+		if (!ok && i == 0)
+		{
+			for (size_t j = 1; j < cnt; j++)
+				frame_release_unlinked(frames[j]);
+			*success = false;
+			return true;
+		}
+		if (ok && i > 0)
+			(*read_ahead)++;
+	}
+	return true;
 }
 
-/* palloc()을 사용하여 프레임을 할당합니다.
- * 사용 가능한 페이지가 없으면 페이지를 교체(evict)하여 반환합니다.
- * 이 함수는 항상 유효한 주소를 반환합니다. 즉, 사용자 풀 메모리가 가득 차면,
- * 이 함수는 프레임을 교체하여 사용 가능한 메모리 공간을 확보합니다.*/
-static struct frame *
-vm_get_frame(void)
+/* 파일 기반 페이지 폴트를 스트림에 기록하고 창 크기를 조절한 뒤 fault-around를 시도합니다.
+ * PAGE를 처리했으면 true(매핑했는지는 SUCCESS), 평범한 한 페이지 경로로 처리해야 하면 false. */
+static bool
+vm_handle_file_fault(struct page *page, struct file_info *info, bool write, bool *success)
 {
-	struct frame *frame = malloc(sizeof(struct frame));
-	ASSERT(frame!=NULL);
-	frame->r_cnt=0;
+	struct ra_stream *stream = ra_stream_get(&thread_current()->spt, file_get_inode(info->file));
+	size_t unused = ra_count_unused(stream);
+	size_t read_ahead = 0;
+	bool handled;
 
-	frame->kva= palloc_get_page(PAL_USER | PAL_ZERO);
-	if(frame->kva==NULL){
-		struct frame * victim=vm_evict_frame(); //이 안에서 swap out
-		ASSERT(victim!=NULL);
-		frame->kva=victim->kva;
-		
-		free(victim );
-	}
-	frame->page=NULL;
+	if (stream->next_va == page->va && unused == 0)
+		stream->window = stream->window == 0 ? 2 : stream->window * 2;
+	else
+		stream->window = stream->window > unused ? (stream->window - unused) / 2 : 0;
+	if (stream->window > RA_MAX_PAGES)
+		stream->window = RA_MAX_PAGES;
 
-	list_push_back(&frame_table->frame_list, &frame->frame_elem);
-	
-	ASSERT(frame != NULL);
-	ASSERT(frame->page == NULL);
-	ASSERT(frame->kva!=NULL);
-	return frame;
+	handled = stream->window > 0 && vm_fault_around(page, info, stream->window, write, &read_ahead, success);
+
+	stream->ra_start = (uint8_t *)page->va + PGSIZE;
+	stream->ra_cnt = read_ahead;
+	stream->next_va = (uint8_t *)page->va + (read_ahead + 1) * PGSIZE;
+	return handled;
 }
 
-/* Growing the stack. */
-static void
-vm_stack_growth(void *addr)
+/* 스왑된 익명 페이지가 이웃 슬롯의 페이지인지 봅니다.
+ * 클러스터로 내보낸 페이지들은 주소와 슬롯이 같은 순서로 이어져 있습니다. */
+static struct page *
+swap_in_candidate(struct supplemental_page_table *spt, void *va, int swap_idx)
 {
-	/* 스택 최하단에 익명 페이지를 추가하여 사용
-	 * addr은 PGSIZE로 내림(정렬)하여 사용	 */
-	vm_alloc_page(VM_ANON, addr, true); // 스택 최하단에 익명 페이지 추가
+	struct page *page = spt_peek_page(spt, va);
+
+	if (page == NULL || VM_TYPE(page->operations->type) != VM_ANON || page->frame != NULL)
+		return NULL;
+	return page->anon.swap_idx == swap_idx ? page : NULL;
 }
 
-/* Handle the fault on write_protected page */
+/* 스왑된 익명 페이지 PAGE의 폴트에서, 같은 클러스터로 내보내졌던(주소와 슬롯이 함께 이어진)
+ * 이웃 페이지들을 한 번의 스왑 읽기로 함께 들여옵니다. 이웃이 없거나 PAGE를 매핑하지 못했으면 false를 돌려
+ * 평범한 한 페이지 경로로 처리하게 합니다. */
 static bool
-vm_handle_wp(struct page *page)
+vm_swap_in_cluster(struct page *page)
 {
-	
-	void * old_kva= page->frame->kva;
-	page->frame->r_cnt--;
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct page *cluster[SWAP_CLUSTER];
+	struct frame *frames[SWAP_CLUSTER];
+	void *kvas[SWAP_CLUSTER];
+	uint8_t *va = page->va;
+	int slot = page->anon.swap_idx;
+	size_t below = 0, above = 0;
+	bool grow_down = slot > 0, grow_up = true;
+
+	while (below + above + 1 < SWAP_CLUSTER && (grow_down || grow_up))
+	{
+		if (grow_down)
+		{
+			if ((int)below + 1 <= slot
+				&& swap_in_candidate(spt, va - (below + 1) * PGSIZE, slot - (int)(below + 1)) != NULL)
+				below++;
+			else
+				grow_down = false;
+		}
+		if (grow_up && below + above + 1 < SWAP_CLUSTER)
+		{
+			if (swap_in_candidate(spt, va + (above + 1) * PGSIZE, slot + (int)(above + 1)) != NULL)
+				above++;
+			else
+				grow_up = false;
+		}
+	}
+	if (below + above == 0)
+		return false;
 
-	struct frame * frame=vm_get_frame();
-	page->frame=frame;
-	frame->page=page;
+	size_t cnt = 0;
+	for (size_t i = below; i > 0; i--)
+		cluster[cnt++] = spt_peek_page(spt, va - i * PGSIZE);
+	cluster[cnt++] = page;
+	for (size_t i = 1; i <= above; i++)
+		cluster[cnt++] = spt_peek_page(spt, va + i * PGSIZE);
 
-	frame->r_cnt++;
+	/* 들여온 뒤에 매핑하지 못하는 일이 없도록 페이지 테이블부터 만들어 둡니다. 모자라면 한 페이지 경로에 맡깁니다 */
+	for (size_t i = 0; i < cnt; i++)
+		if (!vm_reserve_pte(cluster[i]->va))
+			return false;
 
-	
-	if(!pml4_set_page(thread_current()->pml4, page->va, frame->kva, true)){
-		PANIC("TODO");
+	for (size_t i = 0; i < cnt; i++)
+	{
+		frames[i] = vm_get_frame(false);
+		frames[i]->pinned = true;
+		kvas[i] = frames[i]->kva;
 	}
-	memcpy(page->frame->kva, old_kva, PGSIZE);
-
-	return true;
+	anon_swap_in_cluster(cluster, kvas, cnt);
+	/* 스왑 슬롯은 스왑 캐시로 남아 있으므로 매핑하지 못한 이웃은 다음 폴트에서 다시 읽습니다 */
+	bool success = true;
+	for (size_t i = 0; i < cnt; i++)
+		if (!vm_install_frame(cluster[i], frames[i]) && cluster[i] == page)
+			success = false;
+	return success;
 }
 
-/* Return true on success */
 /* 인터럽트 프레임, addr=폴트를 일으킨 주소(코드일 수도있고 데이터일수도 있음),
 user=사용자 접근인지 커널 접근인지, write=true면 쓰기 허용 false면 읽기만
 not_present: true면 존재하지 않는 페이지, false면 권한없어서 페이지 폴트 에러  */
-bool vm_try_handle_fault(struct intr_frame *f , void *addr ,
-						 bool user UNUSED, bool write , bool not_present )
+static bool
+vm_handle_fault(void *addr, bool write, bool not_present, enum vm_stat *kind)
 {
 
 	// ASSERT(addr!=NULL);
@@ -258,32 +2305,115 @@ bool vm_try_handle_fault(struct intr_frame *f , void *addr ,
     struct page *page = spt_find_page(spt, addr);
 	uintptr_t rsp = thread_current()->user_rsp; // 유저 스택의 rsp 가져오기
 
-	if (page && write && !not_present) {
-        if (!page->writable) {  
-            return false;     
-        }
-        return vm_handle_wp(page);
-    }
+	/* 폴트가 난 뒤 회수 스레드나 다른 프로세스의 교체가 이 페이지를 내보냈을 수 있으므로 프레임은 락을 잡고
+	 * 다시 봅니다. 교체는 락을 잡은 채 끝까지 내보내므로, 이미 내보내졌으면 없는 페이지의 폴트로 다시 처리합니다 */
+	if (page && !not_present)
+	{
+		frame_table_lock();
+		if (page->frame == NULL)
+		{
+			frame_table_unlock();
+			not_present = true;
+		}
+		else
+		{
+			evict_policy->touch(page->frame);
+			if (!write || !page->writable)
+			{
+				frame_table_unlock();
+				return false;
+			}
+			*kind = VM_STAT_FAULT_COW;
+			return vm_handle_wp(page);
+		}
+	}
 
-    if (page && !write && !not_present) {
-        return false;
-    }
+	/* 교체가 매핑을 끊고 내보내는 도중에 난 폴트면 page->frame이 아직 남아 있습니다. 교체가 끝나길 기다려
+	 * 실패해서 매핑이 되살아났으면 다시 접근하게 하고, 내보내졌으면 아래에서 다시 들여옵니다 */
+	if (page && not_present && page->frame != NULL)
+	{
+		frame_table_lock();
+		bool mapped = page->frame != NULL && pml4_get_page(thread_current()->pml4, page->va) != NULL;
+		frame_table_unlock();
+		if (mapped)
+			return true;
+	}
 
 
 	if(page){
+		if (!write && page_is_untouched_anon(page))
+		{
+			*kind = VM_STAT_FAULT_ZERO;
+			return vm_map_zero_page(page);
+		}
+
+		struct file_info *info = page_file_info(page);
+		if (info != NULL)
+		{
+			/* 다른 프로세스가 같은 파일 페이지를 이미 읽어 두었으면 디스크를 읽지 않고 그 프레임을 함께 씁니다 */
+			if (!write && vm_map_cached_page(page, info))
+			{
+				*kind = VM_STAT_FAULT_CACHED;
+				return true;
+			}
+			*kind = VM_STAT_FAULT_MAJOR;
+			bool success;
+			if (vm_handle_file_fault(page, info, write, &success))
+				return success;
+
+			/* swap_in(lazy_load_segment)이 파일 정보를 돌려줄 수 있으므로 캐시 키를 먼저 받아 둡니다 */
+			struct inode *inode = file_get_inode(info->file);
+			off_t ofs = info->ofs;
+			size_t read_bytes = info->read_bytes;
+			enum vm_type type = page_file_type(page);
+			if (!vm_do_claim_page(page))
+				return false;
+			return write || vm_cache_page(page, inode, ofs, read_bytes, type);
+		}
+		if (VM_TYPE(page->operations->type) == VM_ANON && page->frame == NULL
+			&& page->anon.swap_idx != -1)
+		{
+			*kind = VM_STAT_FAULT_MAJOR;
+			if (vm_swap_in_cluster(page))
+				return true;
+		}
 		return vm_do_claim_page(page);
 	}
 
     if (page == NULL) {
         if (addr > rsp - PGSIZE && addr >= USER_STACK - (1 << 20) && addr < USER_STACK) {
-            vm_stack_growth(pg_round_down(addr));
-			return true;
+            *kind = VM_STAT_FAULT_STACK;
+            return vm_stack_growth(addr);
 		}
         
         return false;
 	}
 }
 
+/* Return true on success */
+/* 폴트를 처리하고, 처리했으면 폴트 종류와 걸린 시간을 통계에 남깁니다.
+ * 디스크를 읽어야 했던 폴트는 major, 나머지(0 페이지, COW, 페이지 캐시 적중, 스택 확장 등)는 minor로 셉니다. */
+bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr ,
+						 bool user, bool write , bool not_present )
+{
+	enum vm_stat kind = VM_STAT_FAULT_MINOR;
+	int64_t start = timer_ticks();
+	unsigned trace_flags = (write ? VM_TRACE_WRITE : 0) | (not_present ? VM_TRACE_NOT_PRESENT : 0)
+						   | (user ? VM_TRACE_USER : 0);
+
+	vm_trace(VM_TRACE_FAULT, addr, trace_flags, -1);
+	if (!vm_handle_fault(addr, write, not_present, &kind))
+		return false;
+	if (kind == VM_STAT_FAULT_STACK)
+		vm_trace(VM_TRACE_STACK, addr, trace_flags, -1);
+
+	vm_stat_time(kind == VM_STAT_FAULT_MAJOR ? VM_LAT_FAULT_MAJOR : VM_LAT_FAULT_MINOR, timer_elapsed(start));
+	if (kind != VM_STAT_FAULT_MAJOR && kind != VM_STAT_FAULT_MINOR)
+		vm_stat_add(VM_STAT_FAULT_MINOR, 1);
+	vm_stat_add(kind, 1);
+	return true;
+}
+
 /* Free the page.
 프레임 해제, 파일 wriet-back, 페이지 테이블 매핑 해제 등 모든 자원 정리 수행 
  * DO NOT MODIFY THIS FUNCTION. */
@@ -303,26 +2433,36 @@ bool vm_claim_page(void *va)
 	return vm_do_claim_page(page);
 }
 
+/* swap_in이 PAGE의 프레임 한 장을 빠짐없이 덮어쓰는지 봅니다. 스왑 슬롯에서 읽는 익명 페이지와
+ * 파일에서 한 페이지를 꽉 채워 읽는 페이지만 그렇습니다. 나머지(처음 쓰는 익명 페이지, BSS나 mmap 끝처럼
+ * zero_bytes가 있는 페이지, 알 수 없는 초기화 함수)는 이전 주인의 내용이 새지 않도록 0으로 채운 프레임을 씁니다.
+ * 끝부분을 0으로 채우는 일을 로더의 lazy_load_segment에 맡기지 않습니다. */
+static bool
+page_fills_frame(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_ANON)
+		return page->anon.swap_idx != -1;
+	struct file_info *info = page_file_info(page);
+	return info != NULL && info->read_bytes == PGSIZE;
+}
+
 /* PAGE를 요구하고 mmu를 설정합니다*/
 static bool
 vm_do_claim_page(struct page *page)
 {
-	struct frame *frame = vm_get_frame();
+	struct frame *frame = vm_get_frame(!page_fills_frame(page));
 	
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
-	
-	frame->r_cnt++;
+	/* 내용을 채우는 동안(디스크 I/O 중) 다른 스레드의 교체 대상이 되지 않도록 고정된 채 연결합니다 */
+	frame_table_insert(frame, page);
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	if(!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable)){
-		// swap-out? 
-		PANIC("TODO");
-	}
+	if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable))
+		return vm_map_failed(page);
 	
-
-	return swap_in(page, frame->kva);
+	bool success = swap_in(page, frame->kva);
+	frame->pinned = false;
+	return success;
 }
 
 bool is_less(const struct hash_elem *a, const struct hash_elem *b, void *aux){
@@ -338,11 +2478,95 @@ size_t page_hash(const struct hash_elem *e, void * aux){
 	return hash_bytes(&p->va, sizeof p->va);
 }
 
+/* SPT 벤치마크. 커널 커맨드라인 -vm-spt-bench로 부팅 직후 한 번 돌립니다.
+ * 코드/데이터처럼 빽빽한 구간과 스택처럼 멀리 떨어진 구간에 가짜 페이지 SPT_BENCH_PAGES개를 두고,
+ * 기수 트리와 예전 해시(page_hash/is_less)에 대해 삽입, 조회(있는 주소와 없는 주소), 한 페이지씩 지우기에
+ * 걸린 틱을 출력합니다. 해시 함수는 이 비교를 위해서만 남겨 두었습니다. */
+#define SPT_BENCH_PAGES 2048
+#define SPT_BENCH_ROUNDS 32
+
+static void
+spt_run_bench(void)
+{
+	struct page *pages = calloc(SPT_BENCH_PAGES, sizeof *pages);
+	int64_t radix_ticks[3] = {0, 0, 0}, hash_ticks[3] = {0, 0, 0};
+	const uintptr_t miss = (uintptr_t)SPT_BENCH_PAGES * PGSIZE;
+
+	if (pages == NULL)
+	{
+		printf("spt-bench: out of memory\n");
+		return;
+	}
+	for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+		pages[i].va = i < SPT_BENCH_PAGES / 2
+						  ? (void *)(0x400000 + i * PGSIZE)
+						  : (void *)(USER_STACK - (SPT_BENCH_PAGES - i) * PGSIZE);
+
+	for (int round = 0; round < SPT_BENCH_ROUNDS; round++)
+	{
+		struct supplemental_page_table spt;
+		struct hash hash;
+		struct page key;
+		int64_t start;
+
+		spt.root = NULL;
+		spt.page_cnt = 0;
+		if (!hash_init(&hash, page_hash, is_less, NULL))
+			break;
+
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+			spt_insert_page(&spt, &pages[i]);
+		radix_ticks[0] += timer_elapsed(start);
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+			hash_insert(&hash, &pages[i].hash_elem);
+		hash_ticks[0] += timer_elapsed(start);
+
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+			if (spt_peek_page(&spt, pages[i].va) != &pages[i]
+				|| spt_peek_page(&spt, (uint8_t *)pages[i].va + miss) == &pages[i])
+				PANIC("spt-bench: radix lookup mismatch");
+		radix_ticks[1] += timer_elapsed(start);
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+		{
+			key.va = pages[i].va;
+			hash_find(&hash, &key.hash_elem);
+			key.va = (uint8_t *)pages[i].va + miss;
+			hash_find(&hash, &key.hash_elem);
+		}
+		hash_ticks[1] += timer_elapsed(start);
+
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+			spt_remove_page(&spt, &pages[i]);
+		radix_ticks[2] += timer_elapsed(start);
+		start = timer_ticks();
+		for (size_t i = 0; i < SPT_BENCH_PAGES; i++)
+			hash_delete(&hash, &pages[i].hash_elem);
+		hash_ticks[2] += timer_elapsed(start);
+
+		ASSERT(spt.root == NULL && spt.page_cnt == 0);
+		hash_destroy(&hash, NULL);
+	}
+
+	printf("spt-bench: %d pages x %d rounds (ticks) radix insert %"PRId64" lookup %"PRId64" remove %"PRId64
+		   " / hash insert %"PRId64" lookup %"PRId64" remove %"PRId64"\n",
+		   SPT_BENCH_PAGES, SPT_BENCH_ROUNDS, radix_ticks[0], radix_ticks[1], radix_ticks[2],
+		   hash_ticks[0], hash_ticks[1], hash_ticks[2]);
+	free(pages);
+}
+
 /* Initialize new supplemental page table */
+/* 기수 트리의 노드는 첫 삽입 때 만듭니다. */
 void supplemental_page_table_init(struct supplemental_page_table *spt)
 {
-	if(!hash_init(&spt->spt_hash, page_hash, is_less, NULL))
-		return;
+	spt->root = NULL;
+	spt->page_cnt = 0;
+	list_init(&spt->regions);
+	spt->stats = NULL;
 }
 
 
@@ -356,10 +2580,24 @@ static void *duplicate_aux(struct page *src_page, enum vm_type type)
         src_info = (struct file_info *)src_page->file.aux;
     else
         return NULL; // 처리 불가
-
-    struct file_info *dst_info = malloc(sizeof(struct file_info));
-
-    dst_info->file = file_reopen(src_info->file);
+    if (src_info == NULL)
+        return NULL; // 스택처럼 aux 없이 만든 페이지
+
+    struct file_info *dst_info = file_info_alloc();
+    if (dst_info == NULL)
+        return NULL;
+
+    /* 매핑 서술자에서 나온 페이지는 파일을 다시 열지 않고 서술자 참조만 늘립니다 */
+    if (file_info_from_slab(src_info) && src_info->mapping != NULL)
+    {
+        dst_info->file = src_info->file;
+        dst_info->mapping = vm_mapping_get(src_info->mapping);
+    }
+    else
+    {
+        dst_info->file = file_reopen(src_info->file);
+        dst_info->mapping = NULL;
+    }
     dst_info->ofs = src_info->ofs;
     dst_info->upage = src_info->upage;
     dst_info->read_bytes = src_info->read_bytes;
@@ -370,35 +2608,67 @@ static void *duplicate_aux(struct page *src_page, enum vm_type type)
    
 }
 
-bool page_table_copy(struct page* src_page, void *va){
-	struct page *page= spt_find_page(&thread_current()->spt, va);
-	if(page==NULL) return false;
+/* PTE를 읽기 전용으로 바꿉니다. pml4_set_page는 항목을 새로 쓰므로 accessed/dirty 비트를 보존해 다시 세웁니다.
+ * 다시 매핑하지 못하면 항목은 내려간 채로 false를 돌려줍니다. */
+static bool
+page_set_readonly(uint64_t *pml4, void *va, void *kva)
+{
+	bool accessed = pml4_is_accessed(pml4, va);
+	bool dirty = pml4_is_dirty(pml4, va);
 
-	if(page->frame == NULL){
-		page->frame=src_page->frame;
-		page->writable=src_page->writable;
-		src_page->frame->r_cnt++;
-		
-	}
+	pml4_clear_page(pml4, va);
+	if (!pml4_set_page(pml4, va, kva, false))
+		return false;
+	pml4_set_accessed(pml4, va, accessed);
+	pml4_set_dirty(pml4, va, dirty);
+	return true;
+}
+
+/* fork 시 부모 페이지 SRC_PAGE의 프레임을 자식 페이지 DST_PAGE와 copy-on-write로 공유합니다.
+ * 부모와 자식 모두 읽기 전용으로 매핑하고, 실제 복사는 첫 쓰기 때 vm_handle_wp에서 합니다.
+ * 매핑하지 못하면 false를 돌려 fork를 실패시킵니다. 자식에 넣은 역매핑은 자식의 SPT를 없앨 때 정리됩니다. */
+static bool
+page_share_frame(struct page *src_page, struct page *dst_page)
+{
+	struct frame *frame = src_page->frame;
 
-	if(!pml4_set_page(thread_current()->pml4, page->va, src_page->frame->kva, false)){
-		PANIC("TODO");
+	/* 0 페이지는 원래 읽기 전용이고 공유자를 기록하지 않습니다 */
+	if (frame == &zero_frame)
+	{
+		dst_page->frame = frame;
+		return pml4_set_page(thread_current()->pml4, dst_page->va, frame->kva, false);
 	}
 
-	return swap_in(page, src_page->frame->kva);
+	struct frame_map *src_map = frame_find_map(frame, src_page);
+	ASSERT(src_map != NULL);
+	if (src_page->writable && !page_set_readonly(src_map->pml4, src_map->va, frame->kva))
+		return false;
+
+	frame_map_add(frame, dst_page);
+	return pml4_set_page(thread_current()->pml4, dst_page->va, frame->kva, false);
 }
 
+/* fork: 부모의 SPT를 자식에게 복사합니다. 어떤 페이지도 내용을 복사하지 않습니다.
+ *  - uninit 페이지는 같은 초기화 정보로 다시 예약합니다.
+ *  - 메모리에 있는 anon/file 페이지는 부모 프레임을 copy-on-write로 공유합니다.
+ *  - 스왑된 anon 페이지는 같은 스왑 슬롯을 공유하고, 내려간 file 페이지는 파일에서 다시 읽습니다. */
 bool supplemental_page_table_copy(struct supplemental_page_table *dst , struct supplemental_page_table *src )
 {
-   struct hash_iterator i;
-   hash_first(&i, &src->spt_hash);
-   struct thread *cur = thread_current();
+   /* 영역은 매핑 서술자를 공유하는 것으로 물려줍니다(참조 카운트만 늘림). 자식의 첫 폴트에서 페이지가 만들어집니다 */
+   for (struct list_elem *e = list_begin(&src->regions); e != list_end(&src->regions); e = list_next(e))
+   {
+      struct vm_region *r = list_entry(e, struct vm_region, elem);
+      if (!vm_region_attach(r->start, r->length, r->map))
+         return false;
+   }
+
+   struct page *src_page;
+   void *cursor = NULL;
 
-   while (hash_next(&i))
+   while ((src_page = spt_next_page(src, &cursor)) != NULL)
    {
       // src_page 정보
-      struct page *src_page = hash_entry(hash_cur(&i), struct page, hash_elem);
-      enum vm_type type = src_page->operations->type;
+      enum vm_type type = VM_TYPE(src_page->operations->type);
       void *upage = src_page->va;
       bool writable = src_page->writable;
 
@@ -408,66 +2678,83 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst , struct s
 		 enum vm_type reserved_type = src_page->uninit.type;
          vm_initializer *init = src_page->uninit.init;
          void *aux = duplicate_aux(src_page,VM_UNINIT);
-		 ASSERT(aux!=NULL);
 		 
          if(!vm_alloc_page_with_initializer(reserved_type, upage, writable, init, aux))
 		 	return false;
          continue;
       }
 
-      /* 2) type이 file-backed이면 */
-	  else if (type == VM_FILE)
-	  {
-	  
-		  struct file_info *aux = duplicate_aux(src_page, VM_FILE);
-		  ASSERT(aux!=NULL);
-
-		  if (!vm_alloc_page_with_initializer(type, upage, writable, lazy_load_segment, aux))
-			  return false;
-	  
-		  if (!vm_claim_page(upage))
-			  return false;
-	  
-		  continue;
-	  }
-	  else if(type==VM_ANON){
-		  // 3. type이 anon 이면 
-		  if (!vm_alloc_page(type, upage, writable)) // uninit page 생성 & 초기화
-			 // init(lazy_load_segment)는 page_fault가 발생할때 호출됨
-			 // 지금 만드는 페이지는 page_fault가 일어날 때까지 기다리지 않고 바로 내용을 넣어줘야 하므로 필요 없음
-			 return false;
-		
-			if(!page_table_copy(src_page, upage))
-				return false;
-
-			// 매핑된 프레임에 내용 로딩
-			struct page *dst_page = spt_find_page(dst, upage);
-			if(src_page->frame != NULL)
-				memcpy(dst_page->frame->kva, src_page->frame->kva, PGSIZE);
-	}
-	  else{
-		return false;
-	  }
-
-
+      /* 2) anon / file-backed: 초기화 콜백 없이 만들고 곧바로 해당 타입으로 변환합니다 */
+	  if (type != VM_ANON && type != VM_FILE)
+		  return false;
+
+	  void *aux = type == VM_FILE ? duplicate_aux(src_page, VM_FILE) : NULL;
+	  if (!vm_alloc_page_with_initializer(type, upage, writable, NULL, aux))
+		  return false;
+
+	  struct page *dst_page = spt_peek_page(dst, upage);
+	  if (!dst_page->uninit.page_initializer(dst_page, type, NULL))
+		  return false;
+
+	  /* 부모의 프레임은 회수 스레드가 내보내는 중일 수 있으므로 락을 잡고 봅니다 */
+	  frame_table_lock();
+	  bool shared = true;
+	  if (src_page->frame != NULL)
+		  shared = page_share_frame(src_page, dst_page);
+	  else if (type == VM_ANON && src_page->anon.swap_idx != -1)
+		  anon_swap_share(dst_page, src_page);
+	  frame_table_unlock();
+	  if (!shared)
+		  return false;
    }
     return true;
 }
 
-void page_desturctor(struct hash_elem *e, void * aux){
-	struct page *page = hash_entry(e, struct page, hash_elem);
-    if (page->operations->destroy != NULL) {
-        vm_dealloc_page(page);
-    }
-}
 
 
 /* Free the resource hold by the supplemental page table */
 void supplemental_page_table_kill(struct supplemental_page_table *spt)
 {
-	/*hash 테이블 순회하면서 동시에 엔트리 삭제(hash_delete)하면 안됨
-	그럼 내부 구조가 바뀌어버리니 iterator가 안전하게 동작 하지 않음 
-	*/
-	// hash_destroy(&spt->spt_hash, page_desturctor);
-	hash_clear(&spt->spt_hash, page_desturctor);
+	struct page *page;
+	void *cursor;
+
+	/* 페이지마다 따로 쓰지 않도록, 더럽혀진 mmap 페이지를 먼저 모아 오프셋 순으로 합쳐 씁니다.
+	 * 그러면 아래 destroy에서는 매핑과 프레임만 정리합니다 */
+	size_t cnt = 0;
+	for (cursor = NULL; (page = spt_next_page(spt, &cursor)) != NULL;)
+		if (VM_TYPE(page->operations->type) == VM_FILE)
+			cnt++;
+	if (cnt > 0)
+	{
+		struct page **pages = malloc(cnt * sizeof *pages);
+		if (pages != NULL)
+		{
+			size_t n = 0;
+			for (cursor = NULL; (page = spt_next_page(spt, &cursor)) != NULL;)
+				if (VM_TYPE(page->operations->type) == VM_FILE)
+					pages[n++] = page;
+			file_backed_flush_pages(pages, n);
+			free(pages);
+		}
+	}
+
+	/* 주소 순으로 페이지를 없앱니다. 커서는 지운 페이지를 다시 보지 않으므로 트리는 그대로 두었다가
+	 * 마지막에 통째로 풉니다 */
+	for (cursor = NULL; (page = spt_next_page(spt, &cursor)) != NULL;)
+		if (page->operations->destroy != NULL)
+			vm_dealloc_page(page);
+	if (spt->root != NULL)
+		spt_node_destroy(spt->root, SPT_LEVELS - 1);
+	spt->root = NULL;
+	spt->page_cnt = 0;
+
+	while (!list_empty(&spt->regions))
+		vm_region_free(list_entry(list_front(&spt->regions), struct vm_region, elem));
+	vm_stats_free(spt);
+	/* 유령은 교체가 evict_lock을 잡고 남깁니다 */
+	frame_table_lock();
+	twoq_ghost_forget(spt);
+	frame_table_unlock();
+	if (trace_dump)
+		vm_trace_dump(thread_current()->tid);
 }
\ No newline at end of file